@@ -0,0 +1,165 @@
+#include "camctl.h"
+#include <stdio.h>
+#include <string.h>
+#include "qrring.h"
+
+#define CAMCTL_WINDOW_NS 2000000000ULL
+#define CAMCTL_HOLD_NS 3000000000ULL
+#define CAMCTL_RES_HOLD_NS 10000000000ULL
+#define CAMCTL_FPS_HOLD_NS 30000000000ULL
+#define CAMCTL_FPS_HOLD_MAX_NS 480000000000ULL
+
+// 기본값은 원래의 320x240 @ 30 fps 입니다.
+static const int resWidth[CAMCTL_RES_LEVELS] = { 320, 480, 640 };
+static const int resHeight[CAMCTL_RES_LEVELS] = { 240, 360, 480 };
+static const int fpsValue[CAMCTL_FPS_LEVELS] = { 10, 15, 20, 30 };
+
+// /proc/stat 의 첫 줄로 지난 호출 이후 전체 CPU 사용률(%)을 구합니다.
+static double readCpuLoad(struct CameraController* ctl) {
+    FILE* fp = fopen("/proc/stat", "r");
+    if (fp == NULL) {
+        return 0.0;
+    }
+    unsigned long long user, nice, system, idle, iowait, irq, softirq, steal;
+    int n = fscanf(fp, "cpu %llu %llu %llu %llu %llu %llu %llu %llu",
+                   &user, &nice, &system, &idle, &iowait, &irq, &softirq, &steal);
+    fclose(fp);
+    if (n != 8) {
+        return 0.0;
+    }
+
+    uint64_t idleAll = idle + iowait;
+    uint64_t total = user + nice + system + idle + iowait + irq + softirq + steal;
+    double load = 0.0;
+    if (ctl->cpuTotal != 0 && total > ctl->cpuTotal) {
+        load = 100.0 * (1.0 - (double)(idleAll - ctl->cpuIdle) / (total - ctl->cpuTotal));
+    }
+    ctl->cpuIdle = idleAll;
+    ctl->cpuTotal = total;
+    return load;
+}
+
+void camctlInit(struct CameraController* ctl, uint64_t now) {
+    memset(ctl, 0, sizeof(*ctl));
+    ctl->res = 0;
+    ctl->fps = CAMCTL_FPS_LEVELS - 1;
+    ctl->fpsBlocked = -1;
+    ctl->fpsHoldNs = CAMCTL_FPS_HOLD_NS;
+    ctl->windowStartNs = now;
+    ctl->warmup = 1;
+    readCpuLoad(ctl);
+}
+
+std::string camctlCommand(const struct CameraController* ctl) {
+    char cmd[160];
+    snprintf(cmd, sizeof(cmd), "libcamera-vid -t 0 --width %d --height %d --framerate %d --codec mjpeg -o -",
+             resWidth[ctl->res], resHeight[ctl->res], fpsValue[ctl->fps]);
+    return cmd;
+}
+
+void camctlFrame(struct CameraController* ctl, uint64_t now, int candidate, int decoded, uint64_t busyNs) {
+    // libcamera-vid 가 뜨는 데 걸린 시간은 구간에 넣지 않습니다.
+    if (ctl->warmup) {
+        ctl->warmup = 0;
+        ctl->windowStartNs = now;
+    }
+    ctl->frames++;
+    ctl->candidates += candidate ? 1 : 0;
+    ctl->decoded += decoded ? 1 : 0;
+    ctl->busyNs += busyNs;
+}
+
+// 구간(2초)이 끝날 때마다 다음 설정을 고릅니다. 카메라를 다시 띄워야 하면 1 을 돌려줍니다.
+//  - 다시 띄우는 동안은 프레임이 끊기므로, 다음 교차로에서 돌 예정이거나 돌고 있으면 바꾸지 않고 구간을 이어 갑니다.
+//    교차로 QR 을 놓치지 않게 하려는 것이며, 미룬 결정은 돌고 난 뒤 그동안 모인 통계로 내립니다.
+//  - 스캐너가 프레임을 못 따라가면(받은 fps 가 요청의 80% 미만이거나 처리 시간이 90% 이상) 프레임레이트를 내립니다.
+//  - 파인더 패턴은 보이는데 디코딩이 자주 실패하면 해상도를 올립니다.
+//  - 여유가 있으면 프레임레이트를 올리고, 한동안 실패 없이 CPU 가 바쁘면 해상도를 내립니다.
+//    못 따라가서 내렸던 단계로는 30초(같은 단계에서 되풀이되면 최대 8분) 동안 다시 올리지 않고,
+//    올린 뒤의 처리 시간이 70% 를 넘을 것 같아도 올리지 않습니다.
+int camctlUpdate(struct CameraController* ctl, uint64_t now, int maneuver, int turnSignal) {
+    if (ctl->warmup || now - ctl->windowStartNs < CAMCTL_WINDOW_NS) {
+        return 0;
+    }
+    if (turnSignal != 0 || maneuver == MANEUVER_ROTATING) {
+        if (!ctl->held) {
+            printf("Camera: turn %d ahead, holding settings\n", turnSignal);
+            ctl->held = 1;
+        }
+        return 0;
+    }
+    ctl->held = 0;
+
+    double secs = (now - ctl->windowStartNs) / 1e9;
+    double achievedFps = ctl->frames / secs;
+    double busy = ctl->busyNs / 1e9 / secs;
+    double decodeRate = ctl->candidates ? (double)ctl->decoded / ctl->candidates : 0.0;
+    double cpu = readCpuLoad(ctl);
+    int behind = achievedFps < 0.8 * fpsValue[ctl->fps] || busy > 0.9;
+
+    if (ctl->reportEffect) {
+        printf("Camera %dx%d@%d: %.1f fps, decoded %u/%u, busy %.0f%% (before: %.1f fps, decode rate %.0f%%)\n",
+               resWidth[ctl->res], resHeight[ctl->res], fpsValue[ctl->fps], achievedFps,
+               ctl->decoded, ctl->candidates, busy * 100, ctl->prevFps, ctl->prevDecodeRate * 100);
+        ctl->reportEffect = 0;
+    }
+
+    int res = ctl->res;
+    int fps = ctl->fps;
+    const char* reason = NULL;
+    int canSwitch = now - ctl->lastSwitchNs >= CAMCTL_HOLD_NS;
+
+    if (canSwitch) {
+        if (ctl->candidates >= 3 && ctl->decoded * 3 < ctl->candidates) {
+            ctl->lastFailureNs = now;
+        }
+
+        int fpsBlocked = ctl->fpsBlocked >= 0 && now - ctl->fpsBlockedNs < ctl->fpsHoldNs;
+        double nextBusy = fps < CAMCTL_FPS_LEVELS - 1 ? busy * fpsValue[fps + 1] / fpsValue[fps] : 1.0;
+
+        if (behind && fps > 0) {
+            if (fps == ctl->fpsBlocked) {
+                ctl->fpsHoldNs = ctl->fpsHoldNs * 2 < CAMCTL_FPS_HOLD_MAX_NS ? ctl->fpsHoldNs * 2 : CAMCTL_FPS_HOLD_MAX_NS;
+            } else {
+                ctl->fpsHoldNs = CAMCTL_FPS_HOLD_NS;
+            }
+            ctl->fpsBlocked = fps;
+            ctl->fpsBlockedNs = now;
+            fps--;
+            reason = "scanner falling behind";
+        } else if (ctl->candidates >= 3 && ctl->decoded * 3 < ctl->candidates && res < CAMCTL_RES_LEVELS - 1 && cpu < 85) {
+            res++;
+            reason = "decodes failing";
+        } else if (!behind && busy < 0.5 && nextBusy < 0.7 && cpu < 60 && fps < CAMCTL_FPS_LEVELS - 1 &&
+                   !(fpsBlocked && fps + 1 >= ctl->fpsBlocked)) {
+            fps++;
+            reason = "headroom";
+        } else if (res > 0 && now - ctl->lastFailureNs > CAMCTL_RES_HOLD_NS && cpu > 75) {
+            res--;
+            reason = "cpu busy and decodes ok";
+        }
+    }
+
+    int restart = 0;
+    if (res != ctl->res || fps != ctl->fps) {
+        printf("Camera %dx%d@%d -> %dx%d@%d: %s (%.1f fps, decoded %u/%u, busy %.0f%%, cpu %.0f%%)\n",
+               resWidth[ctl->res], resHeight[ctl->res], fpsValue[ctl->fps],
+               resWidth[res], resHeight[res], fpsValue[fps], reason,
+               achievedFps, ctl->decoded, ctl->candidates, busy * 100, cpu);
+        ctl->res = res;
+        ctl->fps = fps;
+        ctl->lastSwitchNs = now;
+        ctl->reportEffect = 1;
+        ctl->prevFps = achievedFps;
+        ctl->prevDecodeRate = decodeRate;
+        ctl->warmup = 1;
+        restart = 1;
+    }
+
+    ctl->windowStartNs = now;
+    ctl->frames = 0;
+    ctl->candidates = 0;
+    ctl->decoded = 0;
+    ctl->busyNs = 0;
+    return restart;
+}
@@ -0,0 +1,43 @@
+#ifndef CAMCTL_H
+#define CAMCTL_H
+
+#include <stdint.h>
+#include <string>
+
+#define CAMCTL_RES_LEVELS 3
+#define CAMCTL_FPS_LEVELS 4
+
+// 인식 결과와 부하를 보고 libcamera-vid 의 해상도/프레임레이트를 바꾸는 제어기
+struct CameraController {
+    int res;               // CAMCTL_RES_LEVELS 중 하나
+    int fps;               // CAMCTL_FPS_LEVELS 중 하나
+    int held;              // 회전을 앞두고 있어 설정 변경을 미루는 중
+
+    // 현재 구간 통계
+    uint64_t windowStartNs;
+    uint32_t frames;
+    uint32_t candidates;   // 디텍터까지 간 프레임
+    uint32_t decoded;
+    uint64_t busyNs;       // 프레임 처리(디코딩~인식)에 쓴 시간
+    int warmup;            // 카메라를 다시 띄운 뒤 첫 프레임을 기다리는 중
+
+    uint64_t lastSwitchNs;
+    int fpsBlocked;        // 못 따라가서 내렸던 프레임레이트 단계. 없으면 -1
+    uint64_t fpsBlockedNs; // 그때 시각
+    uint64_t fpsHoldNs;    // 그 단계로 다시 올리지 않을 시간. 같은 단계에서 또 못 따라가면 두 배로 늘립니다.
+    uint64_t lastFailureNs;
+    uint64_t cpuIdle;
+    uint64_t cpuTotal;
+
+    // 설정을 바꾼 직전 구간의 결과. 바꾼 뒤 효과를 함께 기록합니다.
+    int reportEffect;
+    double prevFps;
+    double prevDecodeRate;
+};
+
+void camctlInit(struct CameraController* ctl, uint64_t now);
+std::string camctlCommand(const struct CameraController* ctl);
+void camctlFrame(struct CameraController* ctl, uint64_t now, int candidate, int decoded, uint64_t busyNs);
+int camctlUpdate(struct CameraController* ctl, uint64_t now, int maneuver, int turnSignal);
+
+#endif /* CAMCTL_H */
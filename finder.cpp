@@ -0,0 +1,331 @@
+#include "finder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <opencv2/imgproc.hpp>
+#include "tracer.h"
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define FINDER_NEON 1
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define FINDER_AVX2 1
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define FINDER_SSE2 1
+#endif
+
+using namespace cv;
+
+const char* finderKernelName(void) {
+#if defined(FINDER_NEON)
+    return "neon";
+#elif defined(FINDER_AVX2)
+    return "avx2";
+#elif defined(FINDER_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+#define FINDER_TILE 16
+
+// 한 줄을 16픽셀 타일로 나눠 타일마다 최소/최대 밝기를 구합니다. 마지막 자투리 타일도 포함합니다.
+static void tileMinMax(const uint8_t* src, int width, uint8_t* tileMin, uint8_t* tileMax) {
+    int t = 0;
+    int i = 0;
+#if defined(FINDER_NEON)
+    for (; i + FINDER_TILE <= width; i += FINDER_TILE, t++) {
+        uint8x16_t p = vld1q_u8(src + i);
+#if defined(__aarch64__)
+        tileMin[t] = vminvq_u8(p);
+        tileMax[t] = vmaxvq_u8(p);
+#else
+        uint8x8_t lo = vpmin_u8(vget_low_u8(p), vget_high_u8(p));
+        uint8x8_t hi = vpmax_u8(vget_low_u8(p), vget_high_u8(p));
+        lo = vpmin_u8(lo, lo);
+        hi = vpmax_u8(hi, hi);
+        lo = vpmin_u8(lo, lo);
+        hi = vpmax_u8(hi, hi);
+        lo = vpmin_u8(lo, lo);
+        hi = vpmax_u8(hi, hi);
+        tileMin[t] = vget_lane_u8(lo, 0);
+        tileMax[t] = vget_lane_u8(hi, 0);
+#endif
+    }
+#elif defined(FINDER_AVX2) || defined(FINDER_SSE2)
+    // 타일이 16픽셀이므로 AVX2 에서도 128비트로 처리하고, 바이트를 반씩 접어 가며 줄입니다.
+    for (; i + FINDER_TILE <= width; i += FINDER_TILE, t++) {
+        __m128i lo = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i hi = lo;
+        lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 8));
+        hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 8));
+        lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 4));
+        hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 4));
+        lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 2));
+        hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 2));
+        lo = _mm_min_epu8(lo, _mm_srli_si128(lo, 1));
+        hi = _mm_max_epu8(hi, _mm_srli_si128(hi, 1));
+        tileMin[t] = (uint8_t)_mm_cvtsi128_si32(lo);
+        tileMax[t] = (uint8_t)_mm_cvtsi128_si32(hi);
+    }
+#endif
+    for (; i < width; i += FINDER_TILE, t++) {
+        int end = i + FINDER_TILE < width ? i + FINDER_TILE : width;
+        uint8_t lo = 255, hi = 0;
+        for (int k = i; k < end; k++) {
+            if (src[k] < lo) lo = src[k];
+            if (src[k] > hi) hi = src[k];
+        }
+        tileMin[t] = lo;
+        tileMax[t] = hi;
+    }
+}
+
+// 픽셀마다 주어진 임계값 근처(lo[i]..hi[i])는 어느 쪽인지 정하지 않습니다.
+// dst[i] = 1(검은색, src < lo), 0(흰색, src > hi), 2(애매함)
+static void binarizeRow(const uint8_t* src, uint8_t* dst, int width, const uint8_t* lo, const uint8_t* hi) {
+    int i = 0;
+#if defined(FINDER_NEON)
+    uint8x16_t one = vdupq_n_u8(1);
+    uint8x16_t two = vdupq_n_u8(2);
+    for (; i + 16 <= width; i += 16) {
+        uint8x16_t p = vld1q_u8(src + i);
+        uint8x16_t dark = vcltq_u8(p, vld1q_u8(lo + i));
+        uint8x16_t light = vcgtq_u8(p, vld1q_u8(hi + i));
+        uint8x16_t unknown = vmvnq_u8(vorrq_u8(dark, light));
+        vst1q_u8(dst + i, vorrq_u8(vandq_u8(dark, one), vandq_u8(unknown, two)));
+    }
+#elif defined(FINDER_AVX2)
+    // 부호 없는 비교가 없으므로 max(p, lo) == p 로 p >= lo, min(p, hi) == p 로 p <= hi 를 구합니다.
+    __m256i one = _mm256_set1_epi8(1);
+    __m256i two = _mm256_set1_epi8(2);
+    for (; i + 32 <= width; i += 32) {
+        __m256i p = _mm256_loadu_si256((const __m256i*)(src + i));
+        __m256i notDark = _mm256_cmpeq_epi8(_mm256_max_epu8(p, _mm256_loadu_si256((const __m256i*)(lo + i))), p);
+        __m256i notLight = _mm256_cmpeq_epi8(_mm256_min_epu8(p, _mm256_loadu_si256((const __m256i*)(hi + i))), p);
+        __m256i unknown = _mm256_and_si256(_mm256_and_si256(notDark, notLight), two);
+        _mm256_storeu_si256((__m256i*)(dst + i), _mm256_or_si256(_mm256_andnot_si256(notDark, one), unknown));
+    }
+#elif defined(FINDER_SSE2)
+    __m128i one = _mm_set1_epi8(1);
+    __m128i two = _mm_set1_epi8(2);
+    for (; i + 16 <= width; i += 16) {
+        __m128i p = _mm_loadu_si128((const __m128i*)(src + i));
+        __m128i notDark = _mm_cmpeq_epi8(_mm_max_epu8(p, _mm_loadu_si128((const __m128i*)(lo + i))), p);
+        __m128i notLight = _mm_cmpeq_epi8(_mm_min_epu8(p, _mm_loadu_si128((const __m128i*)(hi + i))), p);
+        __m128i unknown = _mm_and_si128(_mm_and_si128(notDark, notLight), two);
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(_mm_andnot_si128(notDark, one), unknown));
+    }
+#endif
+    for (; i < width; i++) {
+        dst[i] = src[i] < lo[i] ? 1 : (src[i] > hi[i] ? 0 : 2);
+    }
+}
+
+#define FINDER_MAX_PER_ROW 8
+// detectAndDecode 가 어두운 칸 40 에서 밝은 칸 52 까지(대비 12)도 읽으므로 그보다 흐린 곳만 버립니다.
+#define FINDER_MIN_CONTRAST 12
+
+// 검-흰-검-흰-검 길이가 1:1:3:1:1 에 가까운지 봅니다.
+// 각 칸은 모듈 크기의 절반까지 어긋나도 됩니다 (정수로 7배 해서 비교).
+static int isFinderRatio(const int* count) {
+    int total = count[0] + count[1] + count[2] + count[3] + count[4];
+    if (total < 7) {
+        return 0;
+    }
+    for (int i = 0; i < 5; i++) {
+        if (count[i] == 0) {
+            return 0;
+        }
+    }
+    return 2 * abs(total - 7 * count[0]) < total &&
+           2 * abs(total - 7 * count[1]) < total &&
+           2 * abs(3 * total - 7 * count[2]) < 3 * total &&
+           2 * abs(total - 7 * count[3]) < total &&
+           2 * abs(total - 7 * count[4]) < total;
+}
+
+struct FinderHit {
+    int center;
+    int module;
+};
+
+static int addHit(const int* count, int endX, struct FinderHit* hits, int n) {
+    if (n >= FINDER_MAX_PER_ROW || !isFinderRatio(count)) {
+        return n;
+    }
+    int total = count[0] + count[1] + count[2] + count[3] + count[4];
+    hits[n].center = endX - count[4] - count[3] - count[2] / 2;
+    hits[n].module = total / 7 > 0 ? total / 7 : 1;
+    return n + 1;
+}
+
+// 한 줄에서 1:1:3:1:1 후보들의 가운데 위치를 찾습니다.
+static int scanRow(const uint8_t* bin, int width, struct FinderHit* hits) {
+    int count[5] = { 0, 0, 0, 0, 0 };
+    int state = 0;   // 0,2,4 = 검은색 구간, 1,3 = 흰색 구간
+    int unknown = 0; // 지금 구간 뒤에 이어진 애매한 픽셀 수
+    int n = 0;
+
+    for (int x = 0; x < width; x++) {
+        int dark = bin[x];
+        if (dark == 2) {
+            // 경계의 흐린 픽셀은 지금 구간에 붙이지만, 구간보다 길게 이어지면 패턴이 끝난 것으로 봅니다.
+            if (count[state] == 0) {
+                continue;
+            }
+            if (++unknown > 2 && unknown > count[state]) {
+                if (state == 4) {
+                    n = addHit(count, x + 1 - unknown, hits, n);
+                }
+                memset(count, 0, sizeof(count));
+                state = 0;
+                unknown = 0;
+            }
+            continue;
+        }
+        count[state] += unknown;
+        unknown = 0;
+        if (dark == ((state & 1) == 0)) {
+            count[state]++;
+            continue;
+        }
+        if (state < 4) {
+            // 첫 검은 구간이 나오기 전의 흰색은 건너뜁니다.
+            if (state == 0 && count[0] == 0) {
+                continue;
+            }
+            count[++state]++;
+            continue;
+        }
+        n = addHit(count, x, hits, n);
+        // 검-흰 한 쌍을 밀어내고 흰색 구간부터 다시 셉니다.
+        count[0] = count[2];
+        count[1] = count[3];
+        count[2] = count[4];
+        count[3] = 1;
+        count[4] = 0;
+        state = 3;
+    }
+    if (state == 4) {
+        n = addHit(count, width - unknown, hits, n);
+    }
+    return n;
+}
+
+// 바로 위 두 줄에 같은 자리의 후보가 있었는지 봅니다.
+// 파인더 패턴 가운데의 3모듈 사각형은 적어도 두 줄 이상 이어지므로 잡음에서 생긴 후보를 걸러 냅니다.
+static int isStacked(const struct FinderHit* hit, const struct FinderHit* prev, int prevCount) {
+    for (int i = 0; i < prevCount; i++) {
+        if (abs(hit->center - prev[i].center) <= hit->module && abs(hit->module - prev[i].module) <= hit->module) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+// 파인더 패턴 후보가 세로로 이어진 줄의 수를 돌려줍니다.
+int finderScanRows(const uint8_t* gray, int width, int height, int stride) {
+    if (width <= 0 || height <= 0) {
+        return 0;
+    }
+
+    // 임계값을 정할 때 양옆으로 볼 타일 수. 줄 너비의 1/5 정도(파인더 패턴보다 넓게)를 봅니다.
+    int tiles = (width + FINDER_TILE - 1) / FINDER_TILE;
+    int reach = width / (5 * FINDER_TILE);
+    if (reach < 2) reach = 2;
+
+    std::vector<uint8_t> bin(width);
+    std::vector<uint8_t> lo(width), hi(width);
+    std::vector<uint8_t> tileMin(tiles), tileMax(tiles);
+    struct FinderHit hits[3][FINDER_MAX_PER_ROW];
+    int hitCount[3] = { 0, 0, 0 };
+    int rows = 0;
+    for (int y = 0; y < height; y++) {
+        const uint8_t* row = gray + (size_t)y * stride;
+        struct FinderHit* cur = hits[y % 3];
+        int n = 0;
+
+        // 임계값은 타일마다 주변 타일들의 최소/최대의 가운데로 잡고, 대비의 ±1/8 은 애매한 구간으로 둡니다.
+        // 줄 전체가 아니라 주변만 보므로 멀리 떨어진 반사광이나 그림자가 임계값을 끌고 가지 못합니다.
+        // 파인더 패턴은 대비가 크므로 주변이 밋밋한 타일은 모두 애매한 것으로 두고, 그런 줄은 바로 건너뜁니다.
+        tileMinMax(row, width, tileMin.data(), tileMax.data());
+        int active = 0;
+        for (int t = 0; t < tiles; t++) {
+            int first = t - reach > 0 ? t - reach : 0;
+            int last = t + reach < tiles - 1 ? t + reach : tiles - 1;
+            uint8_t localMin = 255, localMax = 0;
+            for (int k = first; k <= last; k++) {
+                if (tileMin[k] < localMin) localMin = tileMin[k];
+                if (tileMax[k] > localMax) localMax = tileMax[k];
+            }
+
+            int contrast = localMax - localMin;
+            uint8_t tileLo = 0, tileHi = 255;
+            if (contrast >= FINDER_MIN_CONTRAST) {
+                int mid = (localMin + localMax) / 2;
+                tileLo = (uint8_t)(mid - contrast / 8);
+                tileHi = (uint8_t)(mid + contrast / 8);
+                active = 1;
+            }
+            int start = t * FINDER_TILE;
+            int len = start + FINDER_TILE < width ? FINDER_TILE : width - start;
+            memset(lo.data() + start, tileLo, len);
+            memset(hi.data() + start, tileHi, len);
+        }
+        if (active) {
+            binarizeRow(row, bin.data(), width, lo.data(), hi.data());
+            n = scanRow(bin.data(), width, cur);
+        }
+        hitCount[y % 3] = n;
+
+        for (int i = 0; i < n; i++) {
+            if (isStacked(&cur[i], hits[(y + 2) % 3], y >= 1 ? hitCount[(y + 2) % 3] : 0) ||
+                isStacked(&cur[i], hits[(y + 1) % 3], y >= 2 ? hitCount[(y + 1) % 3] : 0)) {
+                rows++;
+                break;
+            }
+        }
+    }
+    return rows;
+}
+
+// 프레임을 축소한 그레이스케일로 바꿔 검사합니다. 0 이면 QR 코드가 없다고 보고 디텍터를 건너뜁니다.
+int finderPrefilter(const Mat& frame, struct FinderStats* stats) {
+    uint64_t start = monotonicNs();
+
+    Mat gray, small;
+    if (frame.channels() == 1) {
+        gray = frame;
+    } else {
+        cvtColor(frame, gray, COLOR_BGR2GRAY);
+    }
+    resize(gray, small, Size(gray.cols / FINDER_SCALE, gray.rows / FINDER_SCALE), 0, 0, INTER_AREA);
+    int rows = finderScanRows(small.ptr(), small.cols, small.rows, (int)small.step);
+
+    if (stats != NULL) {
+        stats->frames++;
+        stats->costNs += monotonicNs() - start;
+        if (rows > 0) {
+            stats->passed++;
+        }
+    }
+    return rows;
+}
+
+// 통계를 출력하고 초기화합니다.
+void finderStatsReport(struct FinderStats* stats) {
+    if (stats->frames == 0) {
+        return;
+    }
+    printf("Prefilter (%s): frames=%llu passed=%llu rejected=%.1f%% decoded=%llu/%llu avg=%.1fus\n",
+           finderKernelName(), (unsigned long long)stats->frames, (unsigned long long)stats->passed,
+           100.0 * (stats->frames - stats->passed) / stats->frames,
+           (unsigned long long)stats->decoded, (unsigned long long)stats->passed,
+           stats->costNs / 1000.0 / stats->frames);
+    memset(stats, 0, sizeof(*stats));
+}
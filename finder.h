@@ -0,0 +1,23 @@
+#ifndef FINDER_H
+#define FINDER_H
+
+#include <stdint.h>
+#include <opencv2/core.hpp>
+
+// 프리필터는 프레임을 절반 크기 그레이스케일로 줄여서 검사합니다.
+#define FINDER_SCALE 2
+
+// detectAndDecode 앞단 프리필터 통계
+struct FinderStats {
+    uint64_t frames;
+    uint64_t passed;     // 후보가 있어 디텍터로 넘긴 프레임
+    uint64_t decoded;    // 넘긴 프레임 중 실제로 디코딩된 프레임
+    uint64_t costNs;     // 프리필터에 쓴 시간 합계
+};
+
+int finderScanRows(const uint8_t* gray, int width, int height, int stride);
+int finderPrefilter(const cv::Mat& frame, struct FinderStats* stats);
+void finderStatsReport(struct FinderStats* stats);
+const char* finderKernelName(void);
+
+#endif /* FINDER_H */
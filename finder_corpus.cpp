@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <opencv2/opencv.hpp>
+#include <opencv2/objdetect.hpp>
+#include "finder.h"
+#include "tracer.h"
+
+using namespace cv;
+using namespace std;
+
+// 프리필터 검증용 프레임 모음(corpus)을 만들고 검사하는 도구입니다.
+//   extract: 녹화한 트레이스에서 프레임을 꺼내 JPEG 로 저장하고, 전체 디텍터 결과로 라벨을 붙입니다.
+//            디텍터가 놓친 태그가 있으면 labels.csv 의 qr 값을 손으로 1 로 고치면 됩니다.
+//   check:   labels.csv 의 모든 프레임에 프리필터를 돌려, 태그가 있는데 걸러진 프레임이 있으면 실패합니다.
+//   synthetic: 트레이스 없이 합성한 파인더 패턴으로 프리필터를 검사합니다. 하나라도 놓치면 실패합니다.
+
+static int extractCorpus(const char* tracePath, const char* dir) {
+    if (traceOpenReplay(tracePath, 0) < 0) {
+        return 1;
+    }
+    mkdir(dir, 0755);
+
+    char path[512];
+    snprintf(path, sizeof(path), "%s/labels.csv", dir);
+    FILE* labels = fopen(path, "w");
+    if (labels == NULL) {
+        perror("labels.csv");
+        traceClose();
+        return 1;
+    }
+    fprintf(labels, "file,qr,data\n");
+
+    QRCodeDetector qrDecoder;
+    int frames = 0, positives = 0;
+    uint32_t len;
+    const uchar* jpeg;
+    while ((jpeg = (const uchar*)traceNext(TRACE_FRAME, &len, NULL)) != NULL) {
+        char name[64];
+        snprintf(name, sizeof(name), "frame_%05d.jpg", frames++);
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+
+        FILE* out = fopen(path, "wb");
+        if (out == NULL) {
+            perror(path);
+            continue;
+        }
+        fwrite(jpeg, 1, len, out);
+        fclose(out);
+
+        vector<uchar> buffer(jpeg, jpeg + len);
+        Mat frame = imdecode(buffer, IMREAD_COLOR);
+        string data = frame.empty() ? string() : qrDecoder.detectAndDecode(frame);
+        if (!data.empty()) {
+            positives++;
+        }
+        fprintf(labels, "%s,%d,%s\n", name, data.empty() ? 0 : 1, data.c_str());
+    }
+
+    fclose(labels);
+    traceClose();
+    printf("Extracted %d frames (%d with QR) into %s\n", frames, positives, dir);
+    return 0;
+}
+
+static int checkCorpus(const char* dir) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/labels.csv", dir);
+    FILE* labels = fopen(path, "r");
+    if (labels == NULL) {
+        perror("labels.csv");
+        return 1;
+    }
+
+    struct FinderStats stats;
+    memset(&stats, 0, sizeof(stats));
+    int positives = 0, negatives = 0, missed = 0, rejected = 0;
+
+    char line[256];
+    while (fgets(line, sizeof(line), labels) != NULL) {
+        char name[128];
+        int qr;
+        if (sscanf(line, "%127[^,],%d", name, &qr) != 2) {
+            continue;   // 머리줄
+        }
+
+        snprintf(path, sizeof(path), "%s/%s", dir, name);
+        Mat frame = imread(path, IMREAD_COLOR);
+        if (frame.empty()) {
+            fprintf(stderr, "Failed to read %s\n", path);
+            continue;
+        }
+
+        int pass = finderPrefilter(frame, &stats) > 0;
+        if (qr) {
+            positives++;
+            if (!pass) {
+                missed++;
+                printf("MISS %s\n", name);
+            }
+        } else {
+            negatives++;
+            if (!pass) {
+                rejected++;
+            }
+        }
+    }
+    fclose(labels);
+
+    printf("Prefilter (%s): %d/%d tagged frames passed, %d/%d untagged frames rejected, avg=%.1fus\n",
+           finderKernelName(), positives - missed, positives, rejected, negatives,
+           stats.frames ? stats.costNs / 1000.0 / stats.frames : 0.0);
+    return missed == 0 ? 0 : 1;
+}
+
+// 축소된 그레이스케일 버퍼(프리필터가 실제로 훑는 크기)에 7x7 모듈 파인더 패턴을 그립니다.
+static void drawFinder(uint8_t* img, int width, int x, int y, int module, uint8_t dark, uint8_t light) {
+    for (int r = 0; r < 7 * module; r++) {
+        for (int c = 0; c < 7 * module; c++) {
+            int my = r / module, mx = c / module;
+            int ring = my == 0 || my == 6 || mx == 0 || mx == 6;
+            int core = my >= 2 && my <= 4 && mx >= 2 && mx <= 4;
+            img[(y + r) * width + x + c] = (ring || core) ? dark : light;
+        }
+    }
+}
+
+// 모듈 크기, 밝기, 위치를 바꿔 가며 패턴 하나씩 그리고, 같은 줄 멀리에 0 과 255 픽셀을 하나씩 둡니다.
+// 줄 전체의 최소/최대로 임계값을 잡으면 이런 픽셀 하나에 끌려가 패턴을 놓칩니다.
+static int checkSynthetic(void) {
+    const int sizes[2][2] = { { 160, 120 }, { 320, 240 } };
+    // 어두운 칸은 40 으로 두고, detectAndDecode 가 읽는 가장 흐린 대비(12)부터 밝은 칸 230 까지 봅니다.
+    const int contrasts[] = { 12, 16, 24, 32, 48, 70, 110, 150, 190 };
+    int tested = 0, missed = 0;
+
+    for (int s = 0; s < 2; s++) {
+        int width = sizes[s][0], height = sizes[s][1];
+        vector<uint8_t> img(width * height);
+        for (int module = 1; module <= width / 40; module++) {
+            for (int c = 0; c < (int)(sizeof(contrasts) / sizeof(contrasts[0])); c++) {
+                int light = 40 + contrasts[c];
+                for (int x = 0; x + 7 * module <= width; x += 9) {
+                    memset(img.data(), light, img.size());
+                    drawFinder(img.data(), width, x, height / 4, module, 40, (uint8_t)light);
+                    int far0 = x > width / 2 ? 2 : width - 3;
+                    int far1 = x > width / 2 ? 10 : width - 12;
+                    for (int y = 0; y < height; y++) {
+                        img[y * width + far0] = 0;
+                        img[y * width + far1] = 255;
+                    }
+
+                    tested++;
+                    if (finderScanRows(img.data(), width, height, width) == 0) {
+                        missed++;
+                        printf("MISS %dx%d module=%d light=%d x=%d\n", width, height, module, light, x);
+                    }
+                }
+            }
+        }
+    }
+
+    printf("Prefilter (%s): %d/%d synthetic patterns passed\n", finderKernelName(), tested - missed, tested);
+    return missed == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc == 4 && strcmp(argv[1], "extract") == 0) {
+        return extractCorpus(argv[2], argv[3]);
+    }
+    if (argc == 3 && strcmp(argv[1], "check") == 0) {
+        return checkCorpus(argv[2]);
+    }
+    if (argc == 2 && strcmp(argv[1], "synthetic") == 0) {
+        return checkSynthetic();
+    }
+
+    fprintf(stderr, "Usage: %s extract <trace> <dir>\n", argv[0]);
+    fprintf(stderr, "       %s check <dir>\n", argv[0]);
+    fprintf(stderr, "       %s synthetic\n", argv[0]);
+    return 1;
+}
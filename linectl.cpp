@@ -0,0 +1,195 @@
+#include "linectl.h"
+#include <stdio.h>
+#include <string.h>
+
+// 게인은 오차(센서 간격 절반) 하나당 바퀴 속도 차이입니다. 트랙에서 바꿀 때는 linesim 으로 먼저 확인합니다.
+static constexpr double LINE_KP = 25.0;
+static constexpr double LINE_KI = 1.5;      // 1초 동안 쌓인 오차 하나당
+static constexpr double LINE_KD = 0.5;      // 초당 오차 변화 하나당
+
+#define LINE_FAST 100            // 라인 가운데일 때 기본 속도
+#define LINE_SLOW 45             // 바깥 센서에 걸렸을 때 기본 속도
+#define LINE_MAX_SPEED 130
+#define LINE_MAX_REVERSE 40      // 안쪽 바퀴를 이 속도까지 거꾸로 돌립니다
+#define LINE_MAX_I_SPEED 25      // 적분 항이 낼 수 있는 최대 속도 차이
+#define LINE_LOST_ERROR (5 * 256)
+#define LINE_MAX_RATE 64         // 추정 위치가 한 틱에 움직일 수 있는 최대 거리 (Q8, 한 단계의 1/4)
+#define LINE_LOST_LIMIT (500000 / LINE_PERIOD_US)
+
+#define LINE_TAPER_SHIFT 5
+#define LINE_TAPER_SIZE ((LINE_LOST_ERROR >> LINE_TAPER_SHIFT) + 1)
+
+static constexpr double periodSec = LINE_PERIOD_US / 1e6;
+static constexpr int32_t kpQ = (int32_t)(LINE_KP * 256 + 0.5);
+static constexpr int32_t kiQ = (int32_t)(LINE_KI * periodSec * 256 + 0.5);
+static constexpr int32_t kdQ = (int32_t)(LINE_KD / periodSec * 256 + 0.5);
+static constexpr int32_t maxIntegral = kiQ > 0 ? (LINE_MAX_I_SPEED << 16) / kiQ : 0;
+static_assert(kiQ > 0, "LINE_KI is too small for LINE_PERIOD_US");
+
+// 패턴별 라인 위치: 라인 위에 있는 센서 위치의 평균
+struct ErrorTable {
+    int32_t v[16];
+};
+
+static constexpr ErrorTable makeErrorTable() {
+    ErrorTable t = {};
+    const int pos[4] = { -3, -1, 1, 3 };
+    for (int p = 0; p < 16; p++) {
+        int sum = 0;
+        int n = 0;
+        for (int s = 0; s < 4; s++) {
+            if (p & (8 >> s)) {
+                sum += pos[s];
+                n++;
+            }
+        }
+        t.v[p] = n ? sum * 256 / n : 0;
+    }
+    return t;
+}
+
+// 오차 크기별 기본 속도: 가운데에서 LINE_FAST, 바깥 센서(3) 이상에서 LINE_SLOW
+struct TaperTable {
+    uint8_t v[LINE_TAPER_SIZE];
+};
+
+static constexpr TaperTable makeTaperTable() {
+    TaperTable t = {};
+    for (int i = 0; i < LINE_TAPER_SIZE; i++) {
+        int e = i << LINE_TAPER_SHIFT;
+        if (e > 3 * 256) e = 3 * 256;
+        t.v[i] = (uint8_t)(LINE_FAST - (LINE_FAST - LINE_SLOW) * e / (3 * 256));
+    }
+    return t;
+}
+
+static constexpr ErrorTable errorTable = makeErrorTable();
+static constexpr TaperTable taperTable = makeTaperTable();
+
+void lineInit(struct LineController* ctl) {
+    memset(ctl, 0, sizeof(*ctl));
+    ctl->crossings = -1;
+}
+
+// 교차로에서 돈 뒤처럼 라인이 바뀌었을 때 이전 오차와 적분을 버립니다.
+void lineReset(struct LineController* ctl) {
+    ctl->integral = 0;
+    ctl->prevError = 0;
+    ctl->lastSeen = 0;
+    ctl->lostTicks = 0;
+    ctl->crossings = -1;
+}
+
+// 패턴이 바뀐 틱을 두 단계의 경계를 지난 때로 보고, 최근 두 경계 사이의 속도로 지금 위치를 이어서 추정합니다.
+// 추정값은 지금 패턴이 가리키는 범위(단계 +-반 단계, 바깥 단계는 라인을 놓치기 전까지) 밖으로 나가지 않습니다.
+// crossings 가 -1 이면 아직 본 단계가 없고, 0 이면 경계를 지난 적이 없습니다.
+static int32_t interpolate(struct LineController* ctl, int32_t level) {
+    if (ctl->crossings < 0) {
+        ctl->level = level;
+        ctl->crossings = 0;
+        return level;
+    }
+
+    if (level != ctl->level) {
+        int32_t cross = (level + ctl->level) / 2;
+        int32_t rate = 0;
+        if (ctl->crossings > 0) {
+            rate = (cross - ctl->cross) / (int32_t)(ctl->ticks - ctl->crossTick);
+            if (rate > LINE_MAX_RATE) rate = LINE_MAX_RATE;
+            if (rate < -LINE_MAX_RATE) rate = -LINE_MAX_RATE;
+            // 되돌아온 경우(잡음 포함)는 속도를 모르므로 경계에 둡니다.
+            if ((rate > 0) != (level > ctl->level)) rate = 0;
+        }
+        ctl->cross = cross;
+        ctl->rate = rate;
+        ctl->crossTick = ctl->ticks;
+        ctl->level = level;
+        ctl->crossings++;
+    }
+    if (ctl->crossings == 0) {
+        return level;
+    }
+
+    int32_t lo = level <= -3 * 256 ? -LINE_LOST_ERROR : level - 128;
+    int32_t hi = level >= 3 * 256 ? LINE_LOST_ERROR : level + 128;
+    int32_t error = ctl->cross + ctl->rate * (int32_t)(ctl->ticks - ctl->crossTick);
+    if (error < lo) error = lo;
+    if (error > hi) error = hi;
+    return error;
+}
+
+static int clampWheel(int speed, int* saturated) {
+    if (speed > LINE_MAX_SPEED) {
+        *saturated = 1;
+        return LINE_MAX_SPEED;
+    }
+    if (speed < -LINE_MAX_REVERSE) {
+        *saturated = 1;
+        return -LINE_MAX_REVERSE;
+    }
+    return speed;
+}
+
+void lineUpdate(struct LineController* ctl, int pattern, struct LineCommand* out) {
+    int32_t error;
+    ctl->ticks++;
+
+    if (pattern != 0) {
+        int32_t level = errorTable.v[pattern & 15];
+        error = interpolate(ctl, level);
+        ctl->lastSeen = level;
+        ctl->lostTicks = 0;
+        out->lost = 0;
+        out->level = level;
+    } else {
+        // 라인을 놓치면 마지막으로 본 쪽 바깥에 있다고 보고 계속 그쪽으로 돕니다.
+        // 가운데에서 놓쳤거나 너무 오래 못 찾으면 끊긴 구간으로 보고 직진합니다.
+        ctl->lostTicks++;
+        ctl->lostTotal++;
+        ctl->crossings = -1;
+        out->lost = 1;
+        if (ctl->lostTicks <= LINE_LOST_LIMIT && ctl->lastSeen >= 256) {
+            error = LINE_LOST_ERROR;
+        } else if (ctl->lostTicks <= LINE_LOST_LIMIT && ctl->lastSeen <= -256) {
+            error = -LINE_LOST_ERROR;
+        } else {
+            error = 0;
+            ctl->integral = 0;
+        }
+        out->level = error;
+    }
+
+    int32_t integral = ctl->integral + error;
+    if (integral > maxIntegral) integral = maxIntegral;
+    if (integral < -maxIntegral) integral = -maxIntegral;
+
+    int32_t u = (kpQ * error + kiQ * integral + kdQ * (error - ctl->prevError)) >> 16;
+    int base = taperTable.v[(error < 0 ? -error : error) >> LINE_TAPER_SHIFT];
+
+    int saturated = 0;
+    int left = clampWheel(base + u, &saturated);
+    int right = clampWheel(base - u, &saturated);
+
+    // 바퀴가 한계에 걸린 채 같은 쪽으로 더 밀고 있으면 적분을 멈춥니다 (anti-windup).
+    if (saturated && (error > 0) == (u > 0)) {
+        ctl->saturated++;
+    } else {
+        ctl->integral = integral;
+    }
+    ctl->prevError = error;
+
+    out->l_dir = left >= 0 ? 1 : 0;
+    out->l_speed = left >= 0 ? left : -left;
+    out->r_dir = right >= 0 ? 1 : 0;
+    out->r_speed = right >= 0 ? right : -right;
+    out->error = error;
+}
+
+void lineReport(struct LineController* ctl) {
+    if (ctl->ticks == 0) {
+        return;
+    }
+    printf("Line: lost %u/%u ticks (%.1f%%), wheels saturated %u ticks (%.1f%%)\n",
+           ctl->lostTotal, ctl->ticks, 100.0 * ctl->lostTotal / ctl->ticks,
+           ctl->saturated, 100.0 * ctl->saturated / ctl->ticks);
+}
@@ -0,0 +1,49 @@
+#ifndef LINECTL_H
+#define LINECTL_H
+
+#include <stdint.h>
+
+// 제어 루프 주기. 게인은 이 주기에 맞춰 컴파일할 때 정수 계수로 바뀝니다.
+#define LINE_PERIOD_US 20000
+
+// 센서 4개가 라인 위(LOW)인지를 비트로 모은 값. left1 이 가장 높은 비트입니다.
+#define LINE_PATTERN(l1, l2, r1, r2) (((l1) << 3) | ((l2) << 2) | ((r1) << 1) | (r2))
+
+// IR 센서 4개로 라인의 좌우 위치를 추정하고, PID 로 좌우 바퀴 속도를 정합니다.
+// 오차는 Q8 고정소수점이며 단위는 센서 간격의 절반입니다 (left1 = -3, left2 = -1, right1 = +1, right2 = +3).
+// 양수면 라인이 오른쪽에 있으므로 오른쪽으로 돕니다.
+// 지금 패턴만으로는 7단계뿐이므로, 패턴이 바뀐 순간을 두 단계의 경계를 지난 때로 보고
+// 최근 두 경계 사이의 속도로 다음 변화까지의 위치를 이어서 추정합니다 (지금 패턴의 범위 안으로 제한).
+struct LineController {
+    int32_t integral;      // 오차 누적 (Q8 x 틱)
+    int32_t prevError;
+    int32_t lastSeen;      // 마지막으로 라인을 본 오차
+    int lostTicks;         // 연속으로 라인을 놓친 틱 수
+
+    int32_t level;         // 지금 패턴의 위치 (Q8)
+    int32_t cross;         // 마지막으로 지난 경계 (Q8)
+    int32_t rate;          // 최근 경계 사이의 이동 속도 (Q8 / 틱)
+    uint32_t crossTick;
+    int crossings;         // 라인을 다시 찾은 뒤 지난 경계 수
+
+    uint32_t ticks;
+    uint32_t lostTotal;
+    uint32_t saturated;    // 바퀴 속도가 한계에 걸려 적분을 멈춘 틱 수
+};
+
+struct LineCommand {
+    int l_dir;
+    int l_speed;
+    int r_dir;
+    int r_speed;
+    int32_t error;         // 이번 틱에 쓴 오차 (Q8)
+    int32_t level;         // 지금 패턴만으로 본 오차 (Q8)
+    int lost;
+};
+
+void lineInit(struct LineController* ctl);
+void lineReset(struct LineController* ctl);
+void lineUpdate(struct LineController* ctl, int pattern, struct LineCommand* out);
+void lineReport(struct LineController* ctl);
+
+#endif /* LINECTL_H */
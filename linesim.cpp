@@ -0,0 +1,273 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <math.h>
+#include "linectl.h"
+
+// 라인트레이싱 시뮬레이터: 같은 트랙에서 기존 bang-bang 조향과 linectl 의 PID 를 비교합니다.
+// 차체와 센서 치수, 속도 환산값은 실제 차에 맞춰 바꿔 가며 씁니다.
+#define SIM_STEP_S 0.001
+#define SIM_MPS_PER_SPEED 0.006     // ctrl_car 속도 1 당 바퀴 속도 (m/s)
+#define SIM_DEADBAND 25             // 이 속도 이하로는 바퀴가 돌지 않습니다
+#define SIM_MOTOR_TAU_S 0.05        // 모터 응답 시정수
+#define SIM_WHEELBASE_M 0.14
+#define SIM_YAW_SLIP 0.35           // 네 바퀴가 미끄러지며 도는 만큼 줄어드는 회전 비율
+#define SIM_SENSOR_AHEAD_M 0.08     // 바퀴 축에서 센서 줄까지
+#define SIM_TAPE_M 0.025
+#define SIM_OFF_TRACK_M 0.08        // 라인에서 이만큼 벗어나면 이탈로 봅니다
+#define SIM_TRACK_POINTS 4000
+#define SIM_SEARCH 150
+
+// left1, left2, right1, right2 의 좌우 위치
+static const double sensorOffset[4] = { -0.031, -0.006, 0.006, 0.031 };
+
+static double trackX[SIM_TRACK_POINTS];
+static double trackY[SIM_TRACK_POINTS];
+static double trackLength;
+
+// 세 개의 볼록한 구간과 오목한 구간이 번갈아 나오는 닫힌 트랙
+static void buildTrack(void) {
+    trackLength = 0.0;
+    for (int i = 0; i < SIM_TRACK_POINTS; i++) {
+        double t = 2 * M_PI * i / SIM_TRACK_POINTS;
+        double r = 0.7 * (1.0 + 0.3 * sin(3 * t));
+        trackX[i] = r * cos(t);
+        trackY[i] = 0.8 * r * sin(t);
+        if (i > 0) {
+            trackLength += hypot(trackX[i] - trackX[i - 1], trackY[i] - trackY[i - 1]);
+        }
+    }
+    trackLength += hypot(trackX[0] - trackX[SIM_TRACK_POINTS - 1], trackY[0] - trackY[SIM_TRACK_POINTS - 1]);
+}
+
+// hint 근처 구간들 중 (x, y) 에서 가장 가까운 거리. hint 는 가장 가까운 점으로 바뀝니다.
+static double trackDistance(double x, double y, int* hint) {
+    double best = 1e9;
+    int bestIndex = *hint;
+    for (int k = -SIM_SEARCH; k <= SIM_SEARCH; k++) {
+        int i = ((*hint + k) % SIM_TRACK_POINTS + SIM_TRACK_POINTS) % SIM_TRACK_POINTS;
+        int j = (i + 1) % SIM_TRACK_POINTS;
+        double dx = trackX[j] - trackX[i];
+        double dy = trackY[j] - trackY[i];
+        double u = ((x - trackX[i]) * dx + (y - trackY[i]) * dy) / (dx * dx + dy * dy);
+        if (u < 0) u = 0;
+        if (u > 1) u = 1;
+        double d = hypot(x - trackX[i] - u * dx, y - trackY[i] - u * dy);
+        if (d < best) {
+            best = d;
+            bestIndex = i;
+        }
+    }
+    *hint = bestIndex;
+    return best;
+}
+
+struct Car {
+    double x, y, heading;
+    double vl, vr;           // 실제 바퀴 속도
+    double cmdL, cmdR;       // 명령한 바퀴 속도
+    int hint;
+};
+
+static double wheelSpeed(int dir, int speed) {
+    return (dir ? 1 : -1) * (speed > SIM_DEADBAND ? speed - SIM_DEADBAND : 0) * SIM_MPS_PER_SPEED;
+}
+
+static void setCommand(struct Car* car, int l_dir, int l_speed, int r_dir, int r_speed) {
+    car->cmdL = wheelSpeed(l_dir, l_speed);
+    car->cmdR = wheelSpeed(r_dir, r_speed);
+}
+
+// 센서 값은 main2 와 같이 라인 위면 0(LOW) 입니다. flip 확률로 잡음을 섞습니다.
+// 잡음과 상관없이 실제로 라인 위에 있는 센서가 하나라도 있으면 1 을 돌려줍니다.
+static int readSensors(struct Car* car, double flip, unsigned* seed, int out[4]) {
+    int seen = 0;
+    double sx = cos(car->heading);
+    double sy = sin(car->heading);
+    for (int s = 0; s < 4; s++) {
+        double x = car->x + SIM_SENSOR_AHEAD_M * sx + sensorOffset[s] * sy;
+        double y = car->y + SIM_SENSOR_AHEAD_M * sy - sensorOffset[s] * sx;
+        int hint = car->hint;
+        int onLine = trackDistance(x, y, &hint) < SIM_TAPE_M / 2;
+        seen |= onLine;
+        if ((double)rand_r(seed) / RAND_MAX < flip) {
+            onLine = !onLine;
+        }
+        out[s] = onLine ? 0 : 1;
+    }
+    return seen;
+}
+
+static int isIntersection(const int s[4]) {
+    int left1 = s[0], left2 = s[1], right1 = s[2], right2 = s[3];
+    return (left1 == 0 && left2 == 0 && right1 == 0 && right2 == 0) ||
+           ((left1 == 0 || left2 == 0) && right2 == 0) ||
+           (left1 == 0 && (right1 == 0 || right2 == 0)) ||
+           (right1 == 0 && right2 == 0) ||
+           (left1 == 0 && left2 == 0);
+}
+
+// 기존 trackingFunction 의 조향. 명령을 유지할 시간(초)을 돌려줍니다.
+// 제자리 회전은 usleep(90000) 뒤 메인 루프의 usleep(100000) 동안에도 계속됩니다.
+static double bangBang(struct Car* car, const int s[4]) {
+    int left1 = s[0], left2 = s[1], right1 = s[2], right2 = s[3];
+    if (isIntersection(s)) {
+        return 0.1;
+    }
+    if ((left2 == 0 && right1 == 0) || (left1 == 1 && left2 == 1 && right1 == 1 && right2 == 1)) {
+        setCommand(car, 1, 60, 1, 60);
+        return 0.1;
+    }
+    if (left1 == 0 || (left2 == 0 && right1 == 1)) {
+        setCommand(car, 0, 50, 1, 50);
+        return 0.19;
+    }
+    if (right2 == 0 || (left2 == 1 && right1 == 0)) {
+        setCommand(car, 1, 50, 0, 50);
+        return 0.19;
+    }
+    setCommand(car, 1, 60, 1, 60);
+    return 0.1;
+}
+
+static double pidTick(struct Car* car, struct LineController* ctl, const int s[4]) {
+    if (!isIntersection(s)) {
+        struct LineCommand cmd;
+        lineUpdate(ctl, LINE_PATTERN(s[0] == 0, s[1] == 0, s[2] == 0, s[3] == 0), &cmd);
+        setCommand(car, cmd.l_dir, cmd.l_speed, cmd.r_dir, cmd.r_speed);
+    }
+    return LINE_PERIOD_US / 1e6;
+}
+
+struct SimResult {
+    int laps;
+    double firstLapS;
+    double lapS;             // 첫 바퀴 이후 평균 랩 타임
+    double lostFraction;     // 라인이 네 센서 밖으로 벗어나 있던 시간 비율
+    int offTrack;
+};
+
+static void simulate(int usePid, int laps, double maxSeconds, double flip, unsigned seed, struct SimResult* result) {
+    struct Car car;
+    memset(&car, 0, sizeof(car));
+    car.x = trackX[0];
+    car.y = trackY[0];
+    car.heading = atan2(trackY[1] - trackY[0], trackX[1] - trackX[0]);
+
+    struct LineController ctl;
+    lineInit(&ctl);
+    memset(result, 0, sizeof(*result));
+
+    double nextTick = 0.0;
+    double lapStart = 0.0;
+    long progress = 0;
+    long lostSteps = 0;
+    long steps = 0;
+    double t = 0.0;
+    int sensors[4];
+
+    for (; t < maxSeconds && result->laps < laps; t += SIM_STEP_S, steps++) {
+        if (!readSensors(&car, flip, &seed, sensors)) {
+            lostSteps++;
+        }
+        if (t >= nextTick) {
+            nextTick += usePid ? pidTick(&car, &ctl, sensors) : bangBang(&car, sensors);
+        }
+
+        car.vl += (car.cmdL - car.vl) * SIM_STEP_S / SIM_MOTOR_TAU_S;
+        car.vr += (car.cmdR - car.vr) * SIM_STEP_S / SIM_MOTOR_TAU_S;
+        double v = (car.vl + car.vr) / 2;
+        car.heading += SIM_YAW_SLIP * (car.vr - car.vl) / SIM_WHEELBASE_M * SIM_STEP_S;
+        car.x += v * cos(car.heading) * SIM_STEP_S;
+        car.y += v * sin(car.heading) * SIM_STEP_S;
+
+        int prev = car.hint;
+        if (trackDistance(car.x, car.y, &car.hint) > SIM_OFF_TRACK_M) {
+            result->offTrack = 1;
+            break;
+        }
+        int delta = car.hint - prev;
+        if (delta > SIM_TRACK_POINTS / 2) delta -= SIM_TRACK_POINTS;
+        if (delta < -SIM_TRACK_POINTS / 2) delta += SIM_TRACK_POINTS;
+        progress += delta;
+        if (progress >= (long)SIM_TRACK_POINTS * (result->laps + 1)) {
+            if (result->laps == 0) {
+                result->firstLapS = t;
+            }
+            result->laps++;
+            if (result->laps > 1) {
+                result->lapS = (t - lapStart) / (result->laps - 1);
+            }
+            if (result->laps == 1) {
+                lapStart = t;
+            }
+        }
+    }
+    result->lostFraction = steps ? (double)lostSteps / steps : 0.0;
+    if (usePid) {
+        lineReport(&ctl);
+    }
+}
+
+static void printResult(const char* name, const struct SimResult* r) {
+    printf("%-10s laps %d, first lap %.2f s, lap %.2f s, line lost %.2f%% of the time%s\n",
+           name, r->laps, r->firstLapS, r->lapS, r->lostFraction * 100, r->offTrack ? ", OFF TRACK" : "");
+}
+
+static uint64_t nowNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// lineUpdate 한 번(제어 틱 하나)에 드는 시간을 잽니다.
+static double benchTick(void) {
+    struct LineController ctl;
+    struct LineCommand cmd;
+    lineInit(&ctl);
+    const int patterns[8] = { 6, 4, 12, 8, 0, 2, 3, 1 };
+    const int count = 10000000;
+    int sink = 0;
+    uint64_t start = nowNs();
+    for (int i = 0; i < count; i++) {
+        lineUpdate(&ctl, patterns[(i >> 4) & 7], &cmd);
+        sink += cmd.l_speed;
+    }
+    uint64_t elapsed = nowNs() - start;
+    if (sink == 42) printf(" ");
+    return (double)elapsed / count;
+}
+
+int main(int argc, char* argv[]) {
+    int laps = 4;
+    double maxSeconds = 300.0;
+    double flip = 0.002;
+    unsigned seed = 1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "l:t:n:s:")) != -1) {
+        switch (opt) {
+            case 'l': laps = atoi(optarg); break;
+            case 't': maxSeconds = atof(optarg); break;
+            case 'n': flip = atof(optarg); break;
+            case 's': seed = strtoul(optarg, NULL, 10); break;
+            default:
+                fprintf(stderr, "Usage: %s [-l laps] [-t seconds] [-n sensor flip probability] [-s seed]\n", argv[0]);
+                return -1;
+        }
+    }
+
+    buildTrack();
+    printf("Track %.2f m, sensor noise %.2f%%, PID period %d us\n", trackLength, flip * 100, LINE_PERIOD_US);
+
+    struct SimResult bang, pid;
+    simulate(0, laps, maxSeconds, flip, seed, &bang);
+    simulate(1, laps, maxSeconds, flip, seed, &pid);
+    printResult("bang-bang", &bang);
+    printResult("pid", &pid);
+    printf("lineUpdate: %.0f ns/tick\n", benchTick());
+
+    return (pid.offTrack || pid.laps < laps) ? 1 : 0;
+}
@@ -9,9 +9,17 @@
 #include <wiringPi.h>
 #include <wiringPiI2C.h>
 #include <signal.h>
+#include <sys/wait.h>
+#include <sys/socket.h>
 #include "server.h"
-#include "qrscanner.h"
+#include "linectl.h"
+#include "pose.h"
+#include "qrring.h"
+#include "rtsched.h"
+#include "tracer.h"
 #include <math.h>
+#include <time.h>
+#include <errno.h>
 
 #define TRACKING_RIGHT1 0
 #define TRACKING_RIGHT2 7
@@ -21,6 +29,21 @@
 #define I2C_ADDR 0x16
 
 int fd;
+pid_t visionPid = -1;
+struct QrRing* visionRing = NULL;
+struct PoseEstimator pose;
+struct LineController line;
+// 제어 루프가 끝나면(재생할 센서 기록이 끝나면) 다른 스레드도 멈춥니다.
+volatile sig_atomic_t controlStopped = 0;
+// Ctrl+C 로 멈추라는 요청. 처리기는 이것만 세우고 정리는 메인 루프가 끝난 뒤에 합니다.
+volatile sig_atomic_t stopRequested = 0;
+volatile sig_atomic_t senderStopped = 0;
+// 마지막 센서 값을 읽은 시각. 재생 중에는 그 센서 기록의 녹화 시각입니다.
+uint64_t sensorNs = 0;
+// 재생 중에만 씁니다. replayReadyNs 는 QR 결과와 행동까지 맞춰 진행한 녹화 시각,
+// visionReplayNs 는 visionSupervisor 가 위치 추정에 넣은 QR 결과의 녹화 시각입니다.
+uint64_t replayReadyNs = 0;
+uint64_t visionReplayNs = 0;
 enum TurnSignal { NO_TURN, LEFT_TURN, RIGHT_TURN, U_TURN };
 
 enum TurnSignal currentTurnSignal = NO_TURN;
@@ -33,11 +56,60 @@ void setup() {
     pinMode(TRACKING_RIGHT2, INPUT);
 }
 
+// 재생 시각을 ts 까지 옮깁니다. 녹화 때 그 사이에 보낸 행동이 있으면 그 시각에서 멈춰 sendAndReceive 가 주고받게 하고,
+// 비전이 있으면 각 시각까지의 프레임이 처리되어 QR 결과가 위치 추정에 들어갈 때까지 기다립니다.
+// 그래서 빠른 재생이나 비전 프로세스가 늦게 뜬 경우에도 행동을 정할 때의 위치 추정이 매번 같습니다.
+void replayAdvance(uint64_t ts) {
+    while (!stopRequested) {
+        uint64_t due;
+        int pending = !senderStopped && tracePeek(TRACE_ACTION, &due) && due <= ts;
+        uint64_t step = pending ? due : ts;
+
+        if (visionRing != NULL) {
+            qrRingSetReplayClock(visionRing, step);
+            while (!stopRequested && __atomic_load_n(&visionReplayNs, __ATOMIC_ACQUIRE) < step) {
+                usleep(100);
+            }
+        }
+        __atomic_store_n(&replayReadyNs, step, __ATOMIC_RELEASE);
+        if (!pending) {
+            return;
+        }
+
+        uint64_t next;
+        while (!senderStopped && !stopRequested && tracePeek(TRACE_ACTION, &next) && next <= step) {
+            usleep(100);
+        }
+    }
+}
+
 void readSensors(int *left1, int *left2, int *right1, int *right2) {
+    if (traceMode == TRACE_REPLAY) {
+        uint32_t len;
+        uint64_t ts;
+        const int* sample = (const int*)traceNext(TRACE_SENSORS, &len, &ts);
+        if (sample == NULL || len != sizeof(int) * 4) {
+            // 트레이스가 끝나면 라인을 놓친 상태로 둡니다.
+            *left1 = *left2 = *right1 = *right2 = HIGH;
+            return;
+        }
+        replayAdvance(ts);
+        __atomic_store_n(&sensorNs, ts, __ATOMIC_RELAXED);
+        *left1 = sample[0];
+        *left2 = sample[1];
+        *right1 = sample[2];
+        *right2 = sample[3];
+        return;
+    }
+
     *left1 = digitalRead(TRACKING_LEFT1);
     *left2 = digitalRead(TRACKING_LEFT2);
     *right1 = digitalRead(TRACKING_RIGHT1);
     *right2 = digitalRead(TRACKING_RIGHT2);
+    __atomic_store_n(&sensorNs, monotonicNs(), __ATOMIC_RELAXED);
+
+    int sample[4] = { *left1, *left2, *right1, *right2 };
+    traceWrite(TRACE_SENSORS, sample, sizeof(sample));
     //printf("left 1 : %d, left2 : %d, right1 : %d, right2 : %d\n", *left1, *left2, *right1, *right2); 
 }
 
@@ -55,14 +127,49 @@ int write_array(int fd, int reg, int* data, int length) {
     return 0;
 }
 
+// 위치 추정에 쓰는 지금 시각. 재생 중에는 녹화 시각 기준인 센서/프레임 시각과 맞추려고 replayAdvance 가 진행한 시각을 씁니다.
+uint64_t controlNowNs(void) {
+    if (traceMode == TRACE_REPLAY) {
+        return __atomic_load_n(&replayReadyNs, __ATOMIC_ACQUIRE);
+    }
+    return monotonicNs();
+}
+
 void ctrl_car(int fd, int l_dir, int l_speed, int r_dir, int r_speed) {
+    // 멈추라는 요청 뒤에는 교차로 회전 중이던 명령이 남아 있어도 다시 움직이지 않습니다.
+    if (stopRequested && (l_speed != 0 || r_speed != 0)) {
+        return;
+    }
     int data[4] = { l_dir, l_speed, r_dir, r_speed };
+    traceWrite(TRACE_MOTOR, data, sizeof(data));
+    if (traceMode == TRACE_REPLAY) {
+        // 녹화된 모터 명령의 시각을 쓰고, 명령이 다르면 알려 줍니다.
+        uint32_t len;
+        uint64_t ts = controlNowNs();
+        const int* recorded = (const int*)traceNext(TRACE_MOTOR, &len, &ts);
+        if (recorded != NULL && len == sizeof(data) && memcmp(recorded, data, sizeof(data)) != 0) {
+            printf("Replay divergence: recorded l_dir=%d, l_speed=%d, r_dir=%d, r_speed=%d\n",
+                   recorded[0], recorded[1], recorded[2], recorded[3]);
+        }
+        poseOnMotor(&pose, ts, l_dir, l_speed, r_dir, r_speed);
+        printf("Replay data: l_dir=%d, l_speed=%d, r_dir=%d, r_speed=%d\n", l_dir, l_speed, r_dir, r_speed);
+        return;
+    }
+    poseOnMotor(&pose, monotonicNs(), l_dir, l_speed, r_dir, r_speed);
     if (write_array(fd, 0x01, data, 4) == 0) {
         printf("Sent data: l_dir=%d, l_speed=%d, r_dir=%d, r_speed=%d\n", l_dir, l_speed, r_dir, r_speed);
     }
 }
 
+// 비전 프로세스가 카메라 설정을 고를 수 있도록 지금의 주행 상태를 알려 줍니다.
+void setManeuver(int maneuver) {
+    if (visionRing != NULL) {
+        qrRingSetManeuver(visionRing, maneuver);
+    }
+}
+
 void car_run(int fd, int speed1, int speed2) {
+    setManeuver(MANEUVER_STRAIGHT);
     ctrl_car(fd, 1, speed1, 1, speed2);
 }
 
@@ -79,22 +186,28 @@ void car_stop(int fd) {
 }
 
 void rotate_left(int fd, int speed1, int speed2, int duration) {
+    setManeuver(MANEUVER_ROTATING);
     car_left(fd, speed1, speed2);
-    usleep(duration);
+    traceUsleep(duration);
     car_stop(fd);
 }
 
 void rotate_right(int fd, int speed1, int speed2, int duration) {
+    setManeuver(MANEUVER_ROTATING);
     car_right(fd, speed1, speed2);
-    usleep(duration);
+    traceUsleep(duration);
     car_stop(fd);
 }
 
+// 처리기가 끼어든 스레드가 락(재생 커서, 위치 추정)을 잡고 있을 수 있으므로 ctrl_car 를 거치지 않습니다.
+// 정지 명령만 I2C 로 바로 쓰고 플래그를 세웁니다. 나머지 정리는 메인 루프가 끝난 뒤에 합니다.
 void handle_signal(int signal) {
     if (signal == SIGINT) {
-        printf("Caught SIGINT, stopping the car...\n");
-        car_stop(fd);
-        exit(0);
+        stopRequested = 1;
+        if (traceMode != TRACE_REPLAY) {
+            int data[4] = { 0, 0, 0, 0 };
+            write_array(fd, 0x01, data, 4);
+        }
     }
 }
 
@@ -105,9 +218,19 @@ enum Direction prevDirection = RIGHT;
 DGIST global_dgist;
 pthread_mutex_t dgistMutex;
 
-extern int qrX;
-extern int qrY;
-extern pthread_mutex_t qrDataMutex;
+int qrX = 0;
+int qrY = 0;
+uint64_t qrFixes = 0;       // 지금까지 받은 QR 결과 수. 바뀌면 sendAndReceive 가 바로 보냅니다.
+pthread_mutex_t qrDataMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t qrDataCond = PTHREAD_COND_INITIALIZER;
+
+const char* schedConfigPath = "sched.conf";
+const char* visionPath = "qrvision";
+const char* recordPath = NULL;
+const char* replayPath = NULL;
+int replayFast = 0;
+int noPrefilter = 0;
+int fixedCamera = 0;
 
 int canMove(int newRow, int newCol) {
     return newRow >= 0 && newRow < MAP_ROW && newCol >= 0 && newCol < MAP_COL;
@@ -278,19 +401,39 @@ enum Direction chooseDirection(DGIST* dgist, int row, int col, enum Direction pr
     return scores[0].direction;
 }
 
-void sendDataToServer(int x, int y) {
-    ClientAction cAction;
+// 재생 중에는 서버 대신 트레이스를 사용하고, 녹화된 행동과 다르면 알려 줍니다.
+ssize_t sendAction(ClientAction* cAction) {
+    if (traceMode == TRACE_REPLAY) {
+        const ClientAction* recorded = (const ClientAction*)traceNext(TRACE_ACTION, NULL, NULL);
+        if (recorded != NULL && (recorded->row != cAction->row || recorded->col != cAction->col || recorded->action != cAction->action)) {
+            printf("Replay divergence: recorded row=%d, col=%d, action=%d\n", recorded->row, recorded->col, recorded->action);
+        }
+        return sizeof(ClientAction);
+    }
 
-    cAction.row = x;
-    cAction.col = y;
-    cAction.action = move;
+    ssize_t bytes_sent = send(clientfd, cAction, sizeof(ClientAction), 0);
+    if (bytes_sent > 0) {
+        traceWrite(TRACE_ACTION, cAction, sizeof(ClientAction));
+    }
+    return bytes_sent;
+}
 
-    ssize_t bytes_sent = send(clientfd, &cAction, sizeof(ClientAction), 0);
-    if (bytes_sent == -1) {
-        perror("send");
-    } else {
-        printf("Sent action to server: row=%d, col=%d, action=%d\n", cAction.row, cAction.col, cAction.action);
+ssize_t recvDgist(DGIST* dgist) {
+    if (traceMode == TRACE_REPLAY) {
+        uint32_t len;
+        const void* recorded = traceNext(TRACE_DGIST, &len, NULL);
+        if (recorded == NULL || len != sizeof(DGIST)) {
+            return 0;
+        }
+        memcpy(dgist, recorded, sizeof(DGIST));
+        return sizeof(DGIST);
+    }
+
+    ssize_t bytes_received = recv(clientfd, dgist, sizeof(DGIST), 0);
+    if (bytes_received > 0) {
+        traceWrite(TRACE_DGIST, dgist, bytes_received);
     }
+    return bytes_received;
 }
 
 void clientPrintMap(DGIST* dgist);
@@ -309,6 +452,9 @@ void setTurnSignal(enum Direction prevDir, enum Direction newDir) {
     } else {
         currentTurnSignal = U_TURN;
     }
+    if (visionRing != NULL) {
+        qrRingSetTurnSignal(visionRing, currentTurnSignal);
+    }
 
     switch (currentTurnSignal) {
         case NO_TURN: printf("No turn\n"); break;
@@ -318,31 +464,85 @@ void setTurnSignal(enum Direction prevDir, enum Direction newDir) {
     }
 }
 
+// 새 QR 결과가 오거나 timeoutUs 가 지날 때까지 기다립니다.
+void waitForQrFix(uint64_t* seenFixes, long timeoutUs) {
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    deadline.tv_sec += timeoutUs / 1000000;
+    deadline.tv_nsec += (timeoutUs % 1000000) * 1000;
+    if (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000;
+    }
+
+    pthread_mutex_lock(&qrDataMutex);
+    while (qrFixes == *seenFixes && !controlStopped) {
+        if (pthread_cond_timedwait(&qrDataCond, &qrDataMutex, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    *seenFixes = qrFixes;
+    pthread_mutex_unlock(&qrDataMutex);
+}
+
 void* sendAndReceive(void* arg) {
     int prevRow = -1, prevCol = -1;
     int processedRow = -1, processedCol = -1;
+    uint64_t seenFixes = 0;
+
+    applySchedConfig(schedConfigPath, "network");
 
     while (1) {
-        ClientAction cAction;
+        // 재생 중에는 녹화 때 행동을 보낸 시각(센서 시계 기준)이 되면 한 번씩 주고받습니다.
+        // 그래야 녹화된 ACTION/DGIST 가 보낸 순서대로 짝지어지고, 다르게 정한 행동은 divergence 로 드러납니다.
+        // 제어 루프가 끝났어도 이미 시각이 된 행동은 마저 주고받습니다.
+        int replayDue = 0;
+        if (traceMode == TRACE_REPLAY) {
+            uint64_t due;
+            if (!tracePeek(TRACE_ACTION, &due) || controlNowNs() < due) {
+                if (controlStopped) {
+                    break;
+                }
+                waitForQrFix(&seenFixes, 1000);
+                continue;
+            }
+            replayDue = 1;
+        } else if (controlStopped) {
+            break;
+        }
 
-        pthread_mutex_lock(&qrDataMutex);
-        cAction.row = qrX;
-        cAction.col = qrY;
+        ClientAction cAction;
         cAction.action = move;
-        pthread_mutex_unlock(&qrDataMutex);
 
-        if (cAction.row != prevRow || cAction.col != prevCol) {
-            if (cAction.row != processedRow || cAction.col != processedCol) {
+        // 마지막 QR 위치 대신, 그 뒤에 지난 교차로와 모터 명령까지 반영한 지금 칸을 씁니다.
+        struct PoseEstimate estimate;
+        int haveEstimate = poseEstimate(&pose, controlNowNs(), &estimate);
+        if (haveEstimate) {
+            cAction.row = estimate.row;
+            cAction.col = estimate.col;
+        } else {
+            pthread_mutex_lock(&qrDataMutex);
+            cAction.row = qrX;
+            cAction.col = qrY;
+            pthread_mutex_unlock(&qrDataMutex);
+        }
+
+        if (replayDue || cAction.row != prevRow || cAction.col != prevCol) {
+            if (replayDue || cAction.row != processedRow || cAction.col != processedCol) {
                 printf("Sending action to server: row=%d, col=%d, action=%d\n", cAction.row, cAction.col, cAction.action);
+                if (haveEstimate) {
+                    printf("Estimate: QR fix %.0f ms old, %d intersections and %.2f cells since\n",
+                           estimate.ageNs / 1e6, estimate.steps, estimate.progress);
+                }
 
-                ssize_t bytes_sent = send(clientfd, &cAction, sizeof(ClientAction), 0);
+                ssize_t bytes_sent = sendAction(&cAction);
                 if (bytes_sent == -1) {
                     perror("send");
                     break;
                 }
 
                 DGIST dgist;
-                ssize_t bytes_received = recv(clientfd, &dgist, sizeof(DGIST), 0);
+                ssize_t bytes_received = recvDgist(&dgist);
                 if (bytes_received == -1) {
                     perror("recv");
                     break;
@@ -372,13 +572,122 @@ void* sendAndReceive(void* arg) {
             prevCol = cAction.col;
         }
 
-        usleep(500000);
+        // QR 을 인식하면 바로 깨어나 추정 위치를 보냅니다. 서버에 보내는 곳은 여기 한 곳뿐입니다.
+        // 재생 중에는 위에서 녹화 시각을 기다리므로 짧게만 쉽니다.
+        waitForQrFix(&seenFixes, traceMode == TRACE_REPLAY ? 1000 : 500000);
+    }
+
+    senderStopped = 1;
+    return NULL;
+}
+
+#define VISION_HEARTBEAT_TIMEOUT_NS 5000000000ULL
+
+// 비전 프로세스를 띄웁니다. 녹화/재생 중이면 같은 트레이스 파일을 넘겨 프레임도 기록/재생하게 합니다.
+pid_t spawnVision(struct QrRing* ring) {
+    const char* args[12];
+    int n = 0;
+    args[n++] = visionPath;
+    if (schedConfigPath != NULL) {
+        args[n++] = "-c";
+        args[n++] = schedConfigPath;
+    }
+    if (noPrefilter) {
+        args[n++] = "-P";
+    }
+    if (fixedCamera) {
+        args[n++] = "-F";
+    }
+    if (replayPath != NULL) {
+        args[n++] = "-p";
+        args[n++] = replayPath;
+        if (replayFast) {
+            args[n++] = "-f";
+        }
+    } else if (recordPath != NULL) {
+        args[n++] = "-r";
+        args[n++] = recordPath;
+    }
+    args[n] = NULL;
+
+    qrRingHeartbeat(ring, monotonicNs());
+    pid_t pid = fork();
+    if (pid == 0) {
+        execvp(visionPath, (char* const*)args);
+        perror("execvp qrvision");
+        _exit(127);
+    } else if (pid < 0) {
+        perror("fork");
+    } else {
+        printf("Started vision process (pid %d)\n", pid);
+    }
+    return pid;
+}
+
+// 비전 프로세스가 올린 QR 결과를 받아 위치 추정에 넘기고, 프로세스가 죽거나 멈추면 다시 띄웁니다.
+void* visionSupervisor(void* arg) {
+    struct QrRing* ring = (struct QrRing*)arg;
+    applySchedConfig(schedConfigPath, "network");
+
+    uint64_t tail = qrRingHead(ring);
+    visionPid = spawnVision(ring);
+
+    while (visionPid > 0 && !controlStopped) {
+        // 끝났는지를 먼저 봐 두어야 끝나기 직전에 올린 결과까지 아래에서 받습니다.
+        int status;
+        int exited = waitpid(visionPid, &status, WNOHANG) == visionPid;
+
+        // 재생 중에는 비전이 처리를 마친 녹화 시각을 먼저 읽고 링을 비운 뒤 알립니다 (replayAdvance 가 기다림).
+        uint64_t frameNs = traceMode == TRACE_REPLAY ? qrRingReplayFrame(ring) : 0;
+        struct QrResult result;
+        while (qrRingPoll(ring, &tail, &result)) {
+            printf("Found QR code: %s (decode %.1f ms)\n", result.data, (result.decodeNs - result.captureNs) / 1e6);
+
+            poseOnFix(&pose, result.x, result.y, result.captureNs);
+
+            // sendAndReceive 를 깨워 이 결과를 반영한 추정 위치를 보내게 합니다.
+            pthread_mutex_lock(&qrDataMutex);
+            qrX = result.x;
+            qrY = result.y;
+            qrFixes++;
+            pthread_cond_signal(&qrDataCond);
+            pthread_mutex_unlock(&qrDataMutex);
+        }
+        if (traceMode == TRACE_REPLAY) {
+            __atomic_store_n(&visionReplayNs, frameNs, __ATOMIC_RELEASE);
+        }
+
+        if (exited) {
+            if ((WIFEXITED(status) && WEXITSTATUS(status) == 0) || traceMode == TRACE_REPLAY) {
+                printf("Vision process exited\n");
+                visionPid = -1;
+                break;
+            }
+            fprintf(stderr, "Vision process died (status %d), restarting\n", status);
+            sleep(1);
+            visionPid = spawnVision(ring);
+        } else if (monotonicNs() - __atomic_load_n(&ring->heartbeatNs, __ATOMIC_RELAXED) > VISION_HEARTBEAT_TIMEOUT_NS) {
+            fprintf(stderr, "Vision process stalled, killing it\n");
+            kill(visionPid, SIGKILL);
+            qrRingHeartbeat(ring, monotonicNs());
+        }
+
+        usleep(traceMode == TRACE_REPLAY ? 100 : 10000);
     }
 
+    if (visionPid > 0) {
+        kill(visionPid, SIGTERM);
+        waitpid(visionPid, NULL, 0);
+        visionPid = -1;
+    }
+    // 비전이 끝났으니 재생 중인 제어 루프가 더 기다리지 않게 합니다.
+    __atomic_store_n(&visionReplayNs, UINT64_MAX, __ATOMIC_RELEASE);
     return NULL;
 }
 
 void trackingFunction(int fd) {
+    // 같은 명령은 다시 보내지 않습니다. 교차로에서 돌고 나면 다시 보냅니다.
+    static int lastMotor[4] = { -1, -1, -1, -1 };
     int left1, left2, right1, right2;
     readSensors(&left1, &left2, &right1, &right2);
 
@@ -388,54 +697,51 @@ void trackingFunction(int fd) {
         (right1 == LOW && right2 == LOW) ||
         (left1 == LOW && left2 == LOW)) {
         printf("Action: at intersection\n");
+        poseOnIntersection(&pose, __atomic_load_n(&sensorNs, __ATOMIC_RELAXED), prevDirection);
         //car_stop(fd);
 
         if (currentTurnSignal == LEFT_TURN) {
             rotate_left(fd, 80, 80, 500000);
-            usleep(50000);
+            traceUsleep(50000);
             car_run(fd, 50, 50);
-            usleep(300000);
+            traceUsleep(300000);
             rotate_left(fd, 80, 80, 500000);
-            usleep(50000);
+            traceUsleep(50000);
         } else if (currentTurnSignal == RIGHT_TURN) {
             rotate_right(fd, 80, 80, 500000);
-            usleep(50000);
+            traceUsleep(50000);
             car_run(fd, 50, 50);
-            usleep(300000);
+            traceUsleep(300000);
             rotate_right(fd, 80, 80, 500000);
-            usleep(50000);
+            traceUsleep(50000);
         } else if (currentTurnSignal == U_TURN) {
             rotate_right(fd, 80, 80, 1000000);
             car_stop(fd);
-            usleep(50000);
+            traceUsleep(50000);
         }
 
+        if (currentTurnSignal != NO_TURN) {
+            lineReset(&line);
+            lastMotor[0] = -1;
+            // 예정된 회전을 마쳤음을 비전 프로세스에 알립니다. 카메라 설정 변경은 이때부터 다시 할 수 있습니다.
+            if (visionRing != NULL) {
+                qrRingSetTurnSignal(visionRing, NO_TURN);
+            }
+        }
         readSensors(&left1, &left2, &right1, &right2);
-    }
-    else if ((left2 == LOW && right1 == LOW) || 
-             (left1 == HIGH && left2 == HIGH && right1 == HIGH && right2 == HIGH)) {
-        printf("Action: Move Forward\n");
-        car_run(fd, 60, 60);
-    }
-    else if (left1 == LOW) {
-        printf("Action: Slight Left\n");
-        car_left(fd, 50, 50);
-        usleep(90000);
-    } else if (right2 == LOW) {
-        printf("Action: Slight Right\n");
-        car_right(fd, 50, 50);
-        usleep(90000);
-    } else if (left2 == LOW && right1 == HIGH) {
-        printf("Action: Slight Left\n");
-        car_left(fd, 50, 50);
-        usleep(90000);
-    } else if (left2 == HIGH && right1 == LOW) {
-        printf("Action: Slight Right\n");
-        car_right(fd, 50, 50);
-        usleep(90000);
     } else {
-        printf("Action: Move Forward\n");
-        car_run(fd, 60, 60);
+        // 센서 패턴과 패턴이 바뀐 시각으로 라인 위치를 추정해 PID 로 좌우 바퀴 속도를 나눕니다 (linectl.cpp).
+        struct LineCommand cmd;
+        lineUpdate(&line, LINE_PATTERN(left1 == LOW, left2 == LOW, right1 == LOW, right2 == LOW), &cmd);
+        setManeuver(MANEUVER_STRAIGHT);
+        if (cmd.l_dir != lastMotor[0] || cmd.l_speed != lastMotor[1] ||
+            cmd.r_dir != lastMotor[2] || cmd.r_speed != lastMotor[3]) {
+            ctrl_car(fd, cmd.l_dir, cmd.l_speed, cmd.r_dir, cmd.r_speed);
+            lastMotor[0] = cmd.l_dir;
+            lastMotor[1] = cmd.l_speed;
+            lastMotor[2] = cmd.r_dir;
+            lastMotor[3] = cmd.r_speed;
+        }
     }
 }
 
@@ -475,65 +781,185 @@ void clientPrintPlayer(DGIST* dgist) {
     printf("==========PRINT DONE==========\n");
 }
 
+static void usage(const char* prog) {
+    fprintf(stderr, "Usage: %s [-c sched.conf] [-n] [-P] [-F] [-r trace] [-s MB] <host> <port>\n", prog);
+    fprintf(stderr, "       %s [-c sched.conf] [-n] [-P] [-F] -p trace [-f]\n", prog);
+}
+
 int main(int argc, char*argv[]) {
-    fd = wiringPiI2CSetup(I2C_ADDR);
-    if (fd == -1) {
-        fprintf(stderr, "Failed to initialize I2C.\n");
-        return -1;
+    size_t traceSizeMB = 256;
+    poseInit(&pose, prevDirection);
+    lineInit(&line);
+    int noVision = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:p:s:fc:nPF")) != -1) {
+        switch (opt) {
+            case 'r': recordPath = optarg; break;
+            case 'p': replayPath = optarg; break;
+            case 's': traceSizeMB = strtoul(optarg, NULL, 10); break;
+            case 'f': replayFast = 1; break;
+            case 'c': schedConfigPath = optarg; break;
+            case 'n': noVision = 1; break;
+            case 'P': noPrefilter = 1; break;
+            case 'F': fixedCamera = 1; break;
+            default: usage(argv[0]); return -1;
+        }
+    }
+
+    // qrvision 은 main2 와 같은 디렉터리에 있다고 봅니다.
+    static char visionPathBuf[PATH_MAX];
+    const char* slash = strrchr(argv[0], '/');
+    if (slash != NULL) {
+        snprintf(visionPathBuf, sizeof(visionPathBuf), "%.*s/qrvision", (int)(slash - argv[0]), argv[0]);
+        visionPath = visionPathBuf;
     }
 
-    printf("I2C initialized successfully.\n");
+    if (replayPath != NULL) {
+        // 재생 모드: I2C 와 서버 없이 녹화된 센서/프레임/서버 응답을 그대로 흘려 보냅니다.
+        if (traceOpenReplay(replayPath, !replayFast) < 0) {
+            return -1;
+        }
+        fd = -1;
+        clientfd = -1;
+    } else {
+        if (argc - optind < 2) {
+            usage(argv[0]);
+            return -1;
+        }
+        if (recordPath != NULL && traceOpenRecord(recordPath, traceSizeMB << 20) < 0) {
+            return -1;
+        }
+    }
+
+    struct addrinfo *hostaddr = NULL;
+    if (traceMode != TRACE_REPLAY) {
+        fd = wiringPiI2CSetup(I2C_ADDR);
+        if (fd == -1) {
+            fprintf(stderr, "Failed to initialize I2C.\n");
+            return -1;
+        }
+
+        printf("I2C initialized successfully.\n");
 
-    setup();
+        setup();
+    }
     
     signal(SIGINT, handle_signal);
     
-    clientfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (clientfd < 0) {
-        perror("Socket function Failed\n");
-        exit(0);
-    }
+    if (traceMode != TRACE_REPLAY) {
+        clientfd = socket(AF_INET, SOCK_STREAM, 0);
+        if (clientfd < 0) {
+            perror("Socket function Failed\n");
+            exit(0);
+        }
 
-    struct addrinfo tmpadd, *hostaddr;
-    memset(&tmpadd, 0, sizeof(tmpadd));
-    tmpadd.ai_family = AF_INET;
-    tmpadd.ai_socktype = SOCK_STREAM;
+        struct addrinfo tmpadd;
+        memset(&tmpadd, 0, sizeof(tmpadd));
+        tmpadd.ai_family = AF_INET;
+        tmpadd.ai_socktype = SOCK_STREAM;
 
-    int hostserver = getaddrinfo(argv[1], argv[2], &tmpadd, &hostaddr);
-    if (hostserver < 0) {
-        perror("No server Found\n");
-        exit(0);
-    }
+        int hostserver = getaddrinfo(argv[optind], argv[optind + 1], &tmpadd, &hostaddr);
+        if (hostserver < 0) {
+            perror("No server Found\n");
+            exit(0);
+        }
 
-    if (connect(clientfd, hostaddr->ai_addr, hostaddr->ai_addrlen) < 0) {
-        perror("Connect Failed\n");
-        close(clientfd);
-        freeaddrinfo(hostaddr);
-        exit(0);
+        if (connect(clientfd, hostaddr->ai_addr, hostaddr->ai_addrlen) < 0) {
+            perror("Connect Failed\n");
+            close(clientfd);
+            freeaddrinfo(hostaddr);
+            exit(0);
+        }
+
+        printf("Server connected\n");
     }
 
-    printf("Server connected\n");
+    struct QrRing* ring = NULL;
+    if (!noVision) {
+        ring = qrRingCreate();
+        if (ring == NULL) {
+            return -1;
+        }
+        // 비전 프로세스도 같은 기준 시각으로 실시간 재생하게 합니다.
+        ring->replayEpochNs = traceReplayEpoch();
+        visionRing = ring;
+    }
 
-    pthread_t sendReceiveThread, qrThread;
+    pthread_t sendReceiveThread, visionThread;
     pthread_mutex_init(&dgistMutex, NULL);
     pthread_mutex_init(&qrDataMutex, NULL);
 
     pthread_create(&sendReceiveThread, NULL, sendAndReceive, NULL);
-    pthread_create(&qrThread, NULL, qrCodeScanner, NULL);
+    if (ring != NULL) {
+        pthread_create(&visionThread, NULL, visionSupervisor, ring);
+    }
 
-    while (1) {
+    // 다른 스레드를 만든 뒤에 제어 루프 스레드만 고정합니다.
+    applySchedConfig(schedConfigPath, "control");
+
+    struct JitterStats jitter;
+    jitterReset(&jitter);
+    const char* jitterLabel = noVision ? "vision stopped" : "vision running";
+
+    // 주기는 고정된 마감 시각에 맞춥니다. 처리 시간만큼 주기가 밀리지 않고, 지터는 마감보다 늦게 깬 시간입니다.
+    // 한 주기 넘게 늦으면 밀린 주기를 몰아서 돌지 않고 지금부터 다시 셉니다.
+    const uint64_t periodNs = LINE_PERIOD_US * 1000ULL;
+    uint64_t deadlineNs = monotonicNs();
+    while (!stopRequested && !traceEnded(TRACE_SENSORS)) {
         trackingFunction(fd);
-        usleep(100000);
+
+        if (traceMode == TRACE_REPLAY) {
+            traceUsleep(LINE_PERIOD_US);
+            continue;
+        }
+        deadlineNs += periodNs;
+        struct timespec deadline;
+        deadline.tv_sec = deadlineNs / 1000000000ULL;
+        deadline.tv_nsec = deadlineNs % 1000000000ULL;
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL) == EINTR && !stopRequested) {
+        }
+        uint64_t now = monotonicNs();
+        uint64_t late = now > deadlineNs ? now - deadlineNs : 0;
+        jitterAdd(&jitter, late);
+        if (late > periodNs) {
+            deadlineNs = now;
+        }
+        if (jitter.count == 100) {
+            jitterReport(&jitter, jitterLabel);
+        }
+    }
+    if (stopRequested) {
+        printf("Caught SIGINT, stopping the car...\n");
+        car_stop(fd);
+        if (traceMode != TRACE_REPLAY) {
+            // 서버 응답을 기다리는 recv 를 깨워 sendAndReceive 가 끝나게 합니다.
+            shutdown(clientfd, SHUT_RDWR);
+        }
     }
 
+    pthread_mutex_lock(&qrDataMutex);
+    controlStopped = 1;
+    pthread_cond_broadcast(&qrDataCond);
+    pthread_mutex_unlock(&qrDataMutex);
+
     pthread_join(sendReceiveThread, NULL);
-    pthread_join(qrThread, NULL);
+    if (ring != NULL) {
+        pthread_join(visionThread, NULL);
+        visionRing = NULL;
+        qrRingClose(ring, 1);
+    }
 
     pthread_mutex_destroy(&dgistMutex);
     pthread_mutex_destroy(&qrDataMutex);
+    poseReport(&pose);
+    lineReport(&line);
 
-    close(clientfd);
-    freeaddrinfo(hostaddr);
+    if (traceMode != TRACE_REPLAY) {
+        close(clientfd);
+        freeaddrinfo(hostaddr);
+    }
+    traceClose();
 
     return 0;
 }
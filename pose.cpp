@@ -0,0 +1,157 @@
+#include "pose.h"
+#include <stdio.h>
+#include <string.h>
+#include "server.h"
+
+// 모터 속도 1 로 1초 달렸을 때 지나는 칸 수. 트랙에서 한 칸 지나는 시간을 재서 맞춥니다.
+#define POSE_CELLS_PER_SPEED_SEC 0.014
+// 교차로 신호가 이보다 짧은 거리 안에서 다시 오면 같은 교차로로 봅니다.
+#define POSE_MIN_EDGE 0.5
+// 교차로 신호 없이 이만큼 달렸으면 교차로를 놓친 것으로 보고 한 칸 진행합니다.
+#define POSE_MISSED_EDGE 1.5
+
+static const int rowDelta[4] = { -1, 1, 0, 0 };
+static const int colDelta[4] = { 0, 0, -1, 1 };
+
+void poseInit(struct PoseEstimator* pose, int heading) {
+    memset(pose, 0, sizeof(*pose));
+    pthread_mutex_init(&pose->lock, NULL);
+    pose->initialHeading = heading;
+}
+
+// 기록이 가득 차면 가장 오래된 항목을 초기 상태에 접어 넣습니다.
+static void appendEvent(struct PoseEstimator* pose, uint64_t ns, int type, int value) {
+    struct PoseEvent* slot = &pose->log[pose->logCount % POSE_LOG_SIZE];
+    if (pose->logCount >= POSE_LOG_SIZE) {
+        if (slot->type == POSE_MOTOR) {
+            pose->initialSpeed = slot->value;
+        } else {
+            pose->initialHeading = slot->value;
+        }
+    }
+    slot->ns = ns;
+    slot->type = type;
+    slot->value = value;
+    pose->logCount++;
+}
+
+void poseOnMotor(struct PoseEstimator* pose, uint64_t ns, int l_dir, int l_speed, int r_dir, int r_speed) {
+    // 제자리 회전은 칸을 옮기지 않으므로 두 바퀴가 모두 앞으로 갈 때만 전진으로 칩니다.
+    int speed = (l_dir == 1 && r_dir == 1) ? (l_speed + r_speed) / 2 : 0;
+    pthread_mutex_lock(&pose->lock);
+    // 조향만 바뀌고 전진 속도가 같은 명령은 기록하지 않아 기록이 금방 차지 않게 합니다.
+    if (speed != pose->currentSpeed) {
+        pose->currentSpeed = speed;
+        appendEvent(pose, ns, POSE_MOTOR, speed);
+    }
+    pthread_mutex_unlock(&pose->lock);
+}
+
+void poseOnIntersection(struct PoseEstimator* pose, uint64_t ns, int heading) {
+    pthread_mutex_lock(&pose->lock);
+    appendEvent(pose, ns, POSE_INTERSECTION, heading);
+    pthread_mutex_unlock(&pose->lock);
+}
+
+// fromNs 에 (row, col) 에 있었다고 보고, 그 뒤의 기록을 다시 돌려 now 의 칸을 구합니다. lock 을 잡고 호출합니다.
+static void predict(struct PoseEstimator* pose, int row, int col, uint64_t fromNs, uint64_t now, struct PoseEstimate* out) {
+    uint64_t i = pose->logCount > POSE_LOG_SIZE ? pose->logCount - POSE_LOG_SIZE : 0;
+    int heading = pose->initialHeading;
+    int speed = pose->initialSpeed;
+
+    for (; i < pose->logCount; i++) {
+        const struct PoseEvent* e = &pose->log[i % POSE_LOG_SIZE];
+        if (e->ns > fromNs) break;
+        if (e->type == POSE_MOTOR) speed = e->value;
+        else heading = e->value;
+    }
+
+    double dist = 0.0;
+    uint64_t t = fromNs;
+    int steps = 0;
+    for (; i < pose->logCount; i++) {
+        const struct PoseEvent* e = &pose->log[i % POSE_LOG_SIZE];
+        if (e->ns > now) break;
+        dist += speed * POSE_CELLS_PER_SPEED_SEC * (e->ns - t) / 1e9;
+        t = e->ns;
+
+        if (e->type == POSE_MOTOR) {
+            speed = e->value;
+            continue;
+        }
+        // 교차로에 닿으면 다음 칸으로 옮기고, 그 교차로에서 돈 뒤의 방향으로 바꿉니다.
+        if (dist >= POSE_MIN_EDGE) {
+            row += rowDelta[heading];
+            col += colDelta[heading];
+            steps++;
+        }
+        dist = 0.0;
+        heading = e->value;
+    }
+    if (now > t) {
+        dist += speed * POSE_CELLS_PER_SPEED_SEC * (now - t) / 1e9;
+    }
+    if (dist >= POSE_MISSED_EDGE) {
+        row += rowDelta[heading];
+        col += colDelta[heading];
+        steps++;
+        dist -= 1.0;
+    }
+
+    if (row < 0) row = 0;
+    if (row >= MAP_ROW) row = MAP_ROW - 1;
+    if (col < 0) col = 0;
+    if (col >= MAP_COL) col = MAP_COL - 1;
+
+    out->row = row;
+    out->col = col;
+    out->heading = heading;
+    out->steps = steps;
+    out->progress = dist;
+    out->ageNs = now > fromNs ? now - fromNs : 0;
+}
+
+// QR 위치가 새 칸이면, 그 프레임을 찍은 시각에 대해 이전 위치로부터의 추정이 맞았는지 함께 기록합니다.
+void poseOnFix(struct PoseEstimator* pose, int row, int col, uint64_t captureNs) {
+    pthread_mutex_lock(&pose->lock);
+    if (pose->haveFix && captureNs < pose->fixNs) {
+        pthread_mutex_unlock(&pose->lock);
+        return;
+    }
+
+    if (pose->haveFix && (row != pose->fixRow || col != pose->fixCol)) {
+        struct PoseEstimate predicted;
+        predict(pose, pose->fixRow, pose->fixCol, pose->fixNs, captureNs, &predicted);
+        pose->checked++;
+        if (predicted.row == row && predicted.col == col) {
+            pose->matched++;
+        } else {
+            printf("Pose check: predicted (%d, %d) after %d intersections, QR says (%d, %d)\n",
+                   predicted.row, predicted.col, predicted.steps, row, col);
+        }
+    }
+
+    pose->haveFix = 1;
+    pose->fixRow = row;
+    pose->fixCol = col;
+    pose->fixNs = captureNs;
+    pthread_mutex_unlock(&pose->lock);
+}
+
+int poseEstimate(struct PoseEstimator* pose, uint64_t now, struct PoseEstimate* out) {
+    pthread_mutex_lock(&pose->lock);
+    int have = pose->haveFix;
+    if (have) {
+        predict(pose, pose->fixRow, pose->fixCol, pose->fixNs, now, out);
+    }
+    pthread_mutex_unlock(&pose->lock);
+    return have;
+}
+
+void poseReport(struct PoseEstimator* pose) {
+    pthread_mutex_lock(&pose->lock);
+    if (pose->checked > 0) {
+        printf("Pose: predicted %u/%u new QR cells correctly\n", pose->matched, pose->checked);
+    }
+    pthread_mutex_unlock(&pose->lock);
+}
@@ -0,0 +1,53 @@
+#ifndef POSE_H
+#define POSE_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+#define POSE_LOG_SIZE 128
+
+// 방향 값은 main2 의 enum Direction { UP, DOWN, LEFT, RIGHT } 순서를 그대로 씁니다.
+enum PoseEventType { POSE_MOTOR, POSE_INTERSECTION };
+
+struct PoseEvent {
+    uint64_t ns;
+    int type;
+    int value;    // POSE_MOTOR: 전진 속도, POSE_INTERSECTION: 교차로를 지난 뒤의 진행 방향
+};
+
+// 마지막 QR 위치와 그 뒤의 모터 명령/교차로 기록으로 지금 칸을 추정합니다.
+struct PoseEstimator {
+    pthread_mutex_t lock;
+    int haveFix;
+    int fixRow;
+    int fixCol;
+    uint64_t fixNs;           // QR 프레임을 찍은 시각
+
+    struct PoseEvent log[POSE_LOG_SIZE];
+    uint64_t logCount;
+    int initialHeading;
+    int initialSpeed;
+    int currentSpeed;         // 마지막으로 기록한 전진 속도
+
+    // 새 칸의 QR 이 올 때마다 그 프레임 시각의 추정과 비교한 결과
+    uint32_t checked;
+    uint32_t matched;
+};
+
+struct PoseEstimate {
+    int row;
+    int col;
+    int heading;
+    int steps;                // QR 위치 이후 지난 교차로 수
+    double progress;          // 마지막 교차로 이후 진행한 칸 수 (오도메트리)
+    uint64_t ageNs;           // 추정에 쓴 QR 프레임의 나이
+};
+
+void poseInit(struct PoseEstimator* pose, int heading);
+void poseOnMotor(struct PoseEstimator* pose, uint64_t ns, int l_dir, int l_speed, int r_dir, int r_speed);
+void poseOnIntersection(struct PoseEstimator* pose, uint64_t ns, int heading);
+void poseOnFix(struct PoseEstimator* pose, int row, int col, uint64_t captureNs);
+int poseEstimate(struct PoseEstimator* pose, uint64_t now, struct PoseEstimate* out);
+void poseReport(struct PoseEstimator* pose);
+
+#endif /* POSE_H */
@@ -0,0 +1,129 @@
+#include "qrring.h"
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static struct QrRing* mapRing(int oflag) {
+    int shmfd = shm_open(QR_RING_NAME, oflag, 0600);
+    if (shmfd < 0) {
+        perror("shm_open");
+        return NULL;
+    }
+    if ((oflag & O_CREAT) && ftruncate(shmfd, sizeof(struct QrRing)) < 0) {
+        perror("ring ftruncate");
+        close(shmfd);
+        return NULL;
+    }
+
+    void* base = mmap(NULL, sizeof(struct QrRing), PROT_READ | PROT_WRITE, MAP_SHARED, shmfd, 0);
+    close(shmfd);
+    if (base == MAP_FAILED) {
+        perror("ring mmap");
+        return NULL;
+    }
+    return (struct QrRing*)base;
+}
+
+// 제어 프로세스가 비전 프로세스를 띄우기 전에 만듭니다.
+struct QrRing* qrRingCreate(void) {
+    struct QrRing* ring = mapRing(O_RDWR | O_CREAT);
+    if (ring == NULL) {
+        return NULL;
+    }
+    memset(ring, 0, sizeof(struct QrRing));
+    ring->slots = QR_RING_SLOTS;
+    __atomic_store_n(&ring->magic, QR_RING_MAGIC, __ATOMIC_RELEASE);
+    return ring;
+}
+
+struct QrRing* qrRingOpen(void) {
+    struct QrRing* ring = mapRing(O_RDWR);
+    if (ring == NULL) {
+        return NULL;
+    }
+    if (__atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != QR_RING_MAGIC || ring->slots != QR_RING_SLOTS) {
+        fprintf(stderr, "QR ring layout mismatch\n");
+        munmap(ring, sizeof(struct QrRing));
+        return NULL;
+    }
+    return ring;
+}
+
+void qrRingClose(struct QrRing* ring, int unlink) {
+    if (ring != NULL) {
+        munmap(ring, sizeof(struct QrRing));
+    }
+    if (unlink) {
+        shm_unlink(QR_RING_NAME);
+    }
+}
+
+void qrRingPublish(struct QrRing* ring, const struct QrResult* result) {
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    // 앞선 head 저장이 슬롯 덮어쓰기보다 먼저 보이게 합니다 (seqlock 의 쓰기 쪽과 같습니다).
+    // 그래야 소비자가 덮어쓴 내용을 읽었다면 qrRingPoll 의 재확인에서 늘어난 head 도 보게 됩니다.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    ring->slot[head % QR_RING_SLOTS] = *result;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void qrRingHeartbeat(struct QrRing* ring, uint64_t now) {
+    __atomic_store_n(&ring->heartbeatNs, now, __ATOMIC_RELAXED);
+}
+
+void qrRingSetManeuver(struct QrRing* ring, int maneuver) {
+    __atomic_store_n(&ring->maneuver, maneuver, __ATOMIC_RELAXED);
+}
+
+void qrRingSetTurnSignal(struct QrRing* ring, int turnSignal) {
+    __atomic_store_n(&ring->turnSignal, turnSignal, __ATOMIC_RELAXED);
+}
+
+void qrRingSetReplayClock(struct QrRing* ring, uint64_t ns) {
+    __atomic_store_n(&ring->replayClockNs, ns, __ATOMIC_RELEASE);
+}
+
+uint64_t qrRingReplayClock(struct QrRing* ring) {
+    return __atomic_load_n(&ring->replayClockNs, __ATOMIC_ACQUIRE);
+}
+
+// 그 시각까지의 결과를 모두 qrRingPublish 한 뒤에 부릅니다. 읽는 쪽은 이 값을 본 뒤 링을 비우면 그 결과를 모두 받습니다.
+void qrRingSetReplayFrame(struct QrRing* ring, uint64_t ns) {
+    __atomic_store_n(&ring->replayFrameNs, ns, __ATOMIC_RELEASE);
+}
+
+uint64_t qrRingReplayFrame(struct QrRing* ring) {
+    return __atomic_load_n(&ring->replayFrameNs, __ATOMIC_ACQUIRE);
+}
+
+uint64_t qrRingHead(struct QrRing* ring) {
+    return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+}
+
+// 새 결과가 있으면 out 에 복사하고 1 을 돌려줍니다.
+// 복사하는 동안 생산자가 한 바퀴 돌아 슬롯을 덮어썼다면 버리고 가장 오래된 유효 슬롯부터 다시 읽습니다.
+int qrRingPoll(struct QrRing* ring, uint64_t* tail, struct QrResult* out) {
+    while (1) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        if (*tail == head) {
+            return 0;
+        }
+        if (head - *tail > QR_RING_SLOTS) {
+            *tail = head - QR_RING_SLOTS;
+        }
+
+        *out = ring->slot[*tail % QR_RING_SLOTS];
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+        if (head - *tail >= QR_RING_SLOTS) {
+            *tail = head - QR_RING_SLOTS + 1;
+            continue;
+        }
+
+        (*tail)++;
+        return 1;
+    }
+}
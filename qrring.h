@@ -0,0 +1,54 @@
+#ifndef QRRING_H
+#define QRRING_H
+
+#include <stdint.h>
+
+#define QR_RING_NAME "/dgist_qr_ring"
+#define QR_RING_MAGIC 0x51524e49
+#define QR_RING_SLOTS 64
+
+// 비전 프로세스가 제어 프로세스로 넘기는 QR 인식 결과
+struct QrResult {
+    uint64_t captureNs;   // 프레임을 다 읽은 시각 (CLOCK_MONOTONIC)
+    uint64_t decodeNs;    // detectAndDecode 가 끝난 시각
+    int x;
+    int y;
+    char data[32];
+};
+
+// 제어 프로세스가 알려 주는 지금의 주행 상태. 비전은 회전 중인지만 봅니다.
+enum Maneuver { MANEUVER_STRAIGHT, MANEUVER_ROTATING };
+
+// 공유 메모리 링. 생산자(비전) 하나, 소비자(제어) 하나이며 락을 쓰지 않습니다.
+// 생산자는 절대 기다리지 않고, 소비자가 늦으면 오래된 결과를 덮어씁니다.
+struct QrRing {
+    uint32_t magic;
+    uint32_t slots;
+    uint64_t head __attribute__((aligned(64)));
+    uint64_t heartbeatNs __attribute__((aligned(64)));
+    int32_t maneuver __attribute__((aligned(64)));   // enum Maneuver
+    int32_t turnSignal;                              // main2 의 enum TurnSignal, 다음 교차로에서 돌 방향. 돌고 나면 0
+
+    // 재생할 때만 씁니다. 두 프로세스가 같은 녹화 시각에 맞춰 움직이게 합니다.
+    uint64_t replayEpochNs __attribute__((aligned(64)));  // 제어 프로세스가 재생을 시작한 시각 (실시간 재생 기준)
+    uint64_t replayClockNs;                              // 제어 쪽이 진행한 녹화 시각. 비전은 여기까지의 프레임만 처리합니다.
+    uint64_t replayFrameNs __attribute__((aligned(64))); // 비전이 이 녹화 시각까지의 프레임을 다 처리함. 끝나면 UINT64_MAX
+    struct QrResult slot[QR_RING_SLOTS] __attribute__((aligned(64)));
+};
+
+struct QrRing* qrRingCreate(void);
+struct QrRing* qrRingOpen(void);
+void qrRingClose(struct QrRing* ring, int unlink);
+
+void qrRingPublish(struct QrRing* ring, const struct QrResult* result);
+void qrRingHeartbeat(struct QrRing* ring, uint64_t now);
+void qrRingSetManeuver(struct QrRing* ring, int maneuver);
+void qrRingSetTurnSignal(struct QrRing* ring, int turnSignal);
+void qrRingSetReplayClock(struct QrRing* ring, uint64_t ns);
+uint64_t qrRingReplayClock(struct QrRing* ring);
+void qrRingSetReplayFrame(struct QrRing* ring, uint64_t ns);
+uint64_t qrRingReplayFrame(struct QrRing* ring);
+uint64_t qrRingHead(struct QrRing* ring);
+int qrRingPoll(struct QrRing* ring, uint64_t* tail, struct QrResult* out);
+
+#endif /* QRRING_H */
@@ -6,45 +6,102 @@
 #include <iostream>
 #include <arpa/inet.h>
 #include <unistd.h>
-#include "server.h"
+#include <string.h>
+#include "camctl.h"
+#include "finder.h"
+#include "qrring.h"
+#include "tracer.h"
 
 using namespace cv;
 using namespace std;
 
-extern int clientfd;
-extern void sendDataToServer(int x, int y);
+volatile sig_atomic_t qrScannerStop = 0;
+int qrPrefilterEnabled = 1;
+int qrAdaptiveCamera = 1;
+int qrReplayFast = 0;
+
+// 다음 MJPEG 프레임을 buffer 에 채우고 찍은 시각을 돌려줍니다.
+// 재생 중에는 녹화된 프레임과 그 녹화 시각을 사용합니다.
+static uint64_t readFrame(FILE* pipe, vector<uchar>& buffer) {
+    buffer.clear();
+
+    if (traceMode == TRACE_REPLAY) {
+        uint32_t len;
+        uint64_t ts = 0;
+        const uchar* recorded = (const uchar*)traceNext(TRACE_FRAME, &len, &ts);
+        if (recorded != NULL) {
+            buffer.assign(recorded, recorded + len);
+        }
+        return ts;
+    }
 
-int qrX = 0;
-int qrY = 0;
-pthread_mutex_t qrDataMutex = PTHREAD_MUTEX_INITIALIZER;
+    char c;
+    while (fread(&c, 1, 1, pipe) == 1) {
+        buffer.push_back(c);
+        if (buffer.size() >= 2 && buffer[buffer.size() - 2] == 0xFF && buffer[buffer.size() - 1] == 0xD9) {
+            // JPEG 이미지의 끝을 나타내는 0xFFD9를 찾았습니다.
+            break;
+        }
+    }
 
-void* qrCodeScanner(void* arg) {
-    // libcamera-vid 명령어를 사용하여 비디오 스트림을 가져옵니다.
-    const string cmd = "libcamera-vid -t 0 --width 320 --height 240 --framerate 30 --codec mjpeg -o -";
+    if (!buffer.empty()) {
+        traceWrite(TRACE_FRAME, buffer.data(), buffer.size());
+    }
+    return monotonicNs();
+}
+
+// libcamera-vid 명령어를 사용하여 비디오 스트림을 가져옵니다.
+static FILE* openCamera(const struct CameraController* camera) {
+    const string cmd = camctlCommand(camera);
     FILE* pipe = popen(cmd.c_str(), "r");
     if (!pipe) {
         cerr << "Error: Unable to open libcamera-vid stream" << endl;
         return NULL;
     }
-    cout << "Opened libcamera-vid stream" << endl;
+    cout << "Opened libcamera-vid stream: " << cmd << endl;
+    return pipe;
+}
+
+void* qrCodeScanner(void* arg) {
+    struct QrRing* ring = (struct QrRing*)arg;
+    struct CameraController camera;
+    camctlInit(&camera, monotonicNs());
+
+    FILE* pipe = NULL;
+    if (traceMode != TRACE_REPLAY) {
+        pipe = openCamera(&camera);
+        if (!pipe) {
+            return NULL;
+        }
+    }
 
     // QR 코드 디텍터 초기화
     QRCodeDetector qrDecoder;
 
     namedWindow("QR Code Scanner", WINDOW_AUTOSIZE);
 
+    struct FinderStats finderStats;
+    memset(&finderStats, 0, sizeof(finderStats));
+
     vector<uchar> buffer;
-    while (true) {
-        buffer.clear();
-        char c;
-        while (fread(&c, 1, 1, pipe) == 1) {
-            buffer.push_back(c);
-            if (buffer.size() >= 2 && buffer[buffer.size() - 2] == 0xFF && buffer[buffer.size() - 1] == 0xD9) {
-                // JPEG 이미지의 끝을 나타내는 0xFFD9를 찾았습니다.
-                break;
+    while (!qrScannerStop) {
+        if (traceMode == TRACE_REPLAY) {
+            // 제어 쪽 재생 시각까지의 프레임만 처리합니다. 앞서 나가면 QR 결과가 녹화 때보다 일찍 위치 추정에 들어갑니다.
+            uint64_t clock = qrRingReplayClock(ring);
+            uint64_t next;
+            if (tracePeek(TRACE_FRAME, &next) && next > clock) {
+                qrRingSetReplayFrame(ring, clock);
+                qrRingHeartbeat(ring, monotonicNs());
+                usleep(100);
+                continue;
             }
         }
 
+        uint64_t captureNs = readFrame(pipe, buffer);
+        // 하트비트와 처리 시간은 재생 중에도 지금 시계로 잽니다.
+        uint64_t frameNs = monotonicNs();
+        qrRingHeartbeat(ring, frameNs);
+
         if (buffer.empty()) {
             cerr << "Error: Captured frame is empty" << endl;
             break;
@@ -56,23 +113,48 @@ void* qrCodeScanner(void* arg) {
             continue;
         }
 
-        // QR 코드 디코딩
-        string data = qrDecoder.detectAndDecode(frame);
+        // QR 코드 디코딩. 파인더 패턴 후보가 없는 프레임은 디텍터를 건너뜁니다.
+        // 카메라 제어기의 후보 수에는 프리필터가 실제로 패턴을 찾은 프레임만 넣습니다 (-P 면 0).
+        string data;
+        int candidate = qrPrefilterEnabled && finderPrefilter(frame, &finderStats) > 0;
+        if (candidate || !qrPrefilterEnabled) {
+            data = qrDecoder.detectAndDecode(frame);
+            if (!data.empty()) {
+                finderStats.decoded++;
+            }
+        }
+        if (finderStats.frames == 100) {
+            finderStatsReport(&finderStats);
+        }
+
+        // 인식 결과와 주행 상태에 따라 카메라 설정을 바꿉니다. 재생 중에는 녹화된 프레임을 그대로 씁니다.
+        uint64_t now = monotonicNs();
+        camctlFrame(&camera, now, candidate, !data.empty(), now - frameNs);
+        if (qrAdaptiveCamera && traceMode != TRACE_REPLAY &&
+            camctlUpdate(&camera, now, __atomic_load_n(&ring->maneuver, __ATOMIC_RELAXED),
+                         __atomic_load_n(&ring->turnSignal, __ATOMIC_RELAXED))) {
+            pclose(pipe);
+            pipe = openCamera(&camera);
+            if (!pipe) {
+                break;
+            }
+        }
+
         if (!data.empty()) {
             cout << "Found QR code: " << data << endl;
 
             // 데이터 분할 및 전역 변수 설정
             if (data.length() >= 2) {
-                int x = data[0] - '0'; // 첫 문자
-                int y = data[1] - '0'; // 두 번째 문자
-
-                pthread_mutex_lock(&qrDataMutex);
-                qrX = x;
-                qrY = y;
-                pthread_mutex_unlock(&qrDataMutex);
-
-                // QR 코드를 인식한 즉시 서버로 데이터 전송
-                sendDataToServer(x, y);
+                struct QrResult result;
+                memset(&result, 0, sizeof(result));
+                result.captureNs = captureNs;
+                result.decodeNs = captureNs + (monotonicNs() - frameNs);
+                result.x = data[0] - '0'; // 첫 문자
+                result.y = data[1] - '0'; // 두 번째 문자
+                strncpy(result.data, data.c_str(), sizeof(result.data) - 1);
+
+                // 제어 프로세스가 받아서 위치 추정에 쓰고, 추정 위치를 바로 서버로 보냅니다.
+                qrRingPublish(ring, &result);
             }
 
             vector<Point> points;
@@ -86,12 +168,15 @@ void* qrCodeScanner(void* arg) {
         }
         imshow("QR Code Scanner", frame);
 
-        if (waitKey(30) == 'q') {
+        // 빠른 재생에서는 창을 갱신할 만큼만 기다립니다.
+        if (waitKey(qrReplayFast ? 1 : 30) == 'q') {
             break;
         }
     }
 
-    pclose(pipe);
+    if (pipe) {
+        pclose(pipe);
+    }
     destroyAllWindows();
     return NULL;
 }
@@ -1,11 +1,13 @@
 #ifndef QRSCANNER_H
 #define QRSCANNER_H
 
-#include <pthread.h>
+#include <signal.h>
 
-extern int qrX;
-extern int qrY;
-extern pthread_mutex_t qrDataMutex;
+// 비전 프로세스(qrvision)에서 실행됩니다. arg 는 결과를 올릴 struct QrRing* 입니다.
+extern volatile sig_atomic_t qrScannerStop;
+extern int qrPrefilterEnabled;
+extern int qrAdaptiveCamera;
+extern int qrReplayFast;
 
 void* qrCodeScanner(void* arg);
 
@@ -0,0 +1,74 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/prctl.h>
+#include "qrscanner.h"
+#include "qrring.h"
+#include "rtsched.h"
+#include "tracer.h"
+
+// main2 가 띄우는 비전 프로세스입니다. 여기서 죽거나 멈춰도 제어 프로세스는 계속 주행합니다.
+
+void handle_term(int signal) {
+    qrScannerStop = 1;
+}
+
+int main(int argc, char* argv[]) {
+    const char* recordPath = NULL;
+    const char* replayPath = NULL;
+    const char* schedConfigPath = NULL;
+    int replayFast = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "r:p:fc:PF")) != -1) {
+        switch (opt) {
+            case 'r': recordPath = optarg; break;
+            case 'p': replayPath = optarg; break;
+            case 'f': replayFast = 1; qrReplayFast = 1; break;
+            case 'c': schedConfigPath = optarg; break;
+            case 'P': qrPrefilterEnabled = 0; break;
+            case 'F': qrAdaptiveCamera = 0; break;
+            default:
+                fprintf(stderr, "Usage: %s [-c sched.conf] [-P] [-F] [-r trace | -p trace [-f]]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // Ctrl+C 는 제어 프로세스가 받아 SIGTERM 으로 정리합니다.
+    signal(SIGINT, SIG_IGN);
+    signal(SIGTERM, handle_term);
+    prctl(PR_SET_PDEATHSIG, SIGTERM);
+
+    applySchedConfig(schedConfigPath, "vision");
+
+    if (replayPath != NULL) {
+        if (traceOpenReplay(replayPath, !replayFast) < 0) {
+            return 1;
+        }
+    } else if (recordPath != NULL) {
+        if (traceAttachRecord(recordPath) < 0) {
+            return 1;
+        }
+    }
+
+    struct QrRing* ring = qrRingOpen();
+    if (ring == NULL) {
+        return 1;
+    }
+    if (replayPath != NULL) {
+        traceSetReplayEpoch(ring->replayEpochNs);
+    }
+
+    qrCodeScanner(ring);
+    if (replayPath != NULL) {
+        // 남은 프레임이 없으니 제어 쪽이 더 기다리지 않게 합니다.
+        qrRingSetReplayFrame(ring, UINT64_MAX);
+    }
+
+    // 종료 요청이나 재생 끝이 아닌데 멈췄다면 제어 프로세스가 다시 띄우도록 실패로 끝냅니다.
+    int status = (qrScannerStop || traceEnded(TRACE_FRAME)) ? 0 : 1;
+    qrRingClose(ring, 0);
+    traceClose();
+    return status;
+}
@@ -0,0 +1,151 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "rtsched.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+
+// "0-1,3" 같은 CPU 목록을 cpu_set_t 로 바꿉니다.
+static int parseCpuList(const char* list, cpu_set_t* set) {
+    CPU_ZERO(set);
+    const char* p = list;
+    while (*p) {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p || first < 0 || first >= CPU_SETSIZE) {
+            return -1;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1 || last < first || last >= CPU_SETSIZE) {
+                return -1;
+            }
+            p = end;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, set);
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int parsePolicy(const char* name) {
+    if (strcmp(name, "fifo") == 0) return SCHED_FIFO;
+    if (strcmp(name, "rr") == 0) return SCHED_RR;
+    if (strcmp(name, "other") == 0) return SCHED_OTHER;
+    return -1;
+}
+
+// 설정 파일에서 role 에 해당하는 줄을 찾아 호출한 스레드에 CPU 고정과 스케줄링 정책을 적용합니다.
+// 한 줄의 형식: <role> <cpus> <policy> <priority>   예) control 3 fifo 80
+// 이후에 만드는 스레드(와 exec 한 프로세스)는 이 설정을 물려받습니다.
+int applySchedConfig(const char* path, const char* role) {
+    if (path == NULL) {
+        return 0;
+    }
+
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) {
+        fprintf(stderr, "Sched config %s not found, running unpinned\n", path);
+        return -1;
+    }
+
+    char line[256];
+    int lineNo = 0;
+    int found = 0;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        lineNo++;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+
+        char name[32], cpus[64], policyName[16];
+        int priority;
+        int n = sscanf(line, "%31s %63s %15s %d", name, cpus, policyName, &priority);
+        if (n <= 0) continue;
+        if (n != 4) {
+            fprintf(stderr, "%s:%d: expected <role> <cpus> <policy> <priority>\n", path, lineNo);
+            continue;
+        }
+        if (strcmp(name, role) != 0) continue;
+        found = 1;
+
+        cpu_set_t set;
+        if (parseCpuList(cpus, &set) < 0) {
+            fprintf(stderr, "%s:%d: bad cpu list '%s'\n", path, lineNo, cpus);
+            break;
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (err != 0) {
+            fprintf(stderr, "%s: pthread_setaffinity_np: %s\n", role, strerror(err));
+        }
+
+        int policy = parsePolicy(policyName);
+        if (policy < 0) {
+            fprintf(stderr, "%s:%d: unknown policy '%s'\n", path, lineNo, policyName);
+            break;
+        }
+        struct sched_param param;
+        memset(&param, 0, sizeof(param));
+        param.sched_priority = (policy == SCHED_OTHER) ? 0 : priority;
+        err = pthread_setschedparam(pthread_self(), policy, &param);
+        if (err != 0) {
+            fprintf(stderr, "%s: pthread_setschedparam: %s\n", role, strerror(err));
+        }
+
+        printf("Sched %s: cpus=%s policy=%s priority=%d\n", role, cpus, policyName, param.sched_priority);
+        break;
+    }
+
+    fclose(fp);
+    return found ? 0 : -1;
+}
+
+void jitterReset(struct JitterStats* stats) {
+    memset(stats, 0, sizeof(*stats));
+    stats->minNs = UINT64_MAX;
+}
+
+void jitterAdd(struct JitterStats* stats, uint64_t lateNs) {
+    stats->count++;
+    stats->sumNs += lateNs;
+    if (lateNs < stats->minNs) stats->minNs = lateNs;
+    if (lateNs > stats->maxNs) stats->maxNs = lateNs;
+
+    uint64_t bucket = lateNs / JITTER_BUCKET_NS;
+    if (bucket >= JITTER_BUCKETS) bucket = JITTER_BUCKETS - 1;
+    stats->hist[bucket]++;
+}
+
+// 통계를 출력하고 초기화합니다. p99 는 히스토그램 구간의 상한값입니다.
+void jitterReport(struct JitterStats* stats, const char* label) {
+    if (stats->count == 0) {
+        return;
+    }
+
+    uint64_t target = stats->count - stats->count / 100;
+    uint64_t seen = 0;
+    int p99 = JITTER_BUCKETS - 1;
+    for (int i = 0; i < JITTER_BUCKETS; i++) {
+        seen += stats->hist[i];
+        if (seen >= target) {
+            p99 = i;
+            break;
+        }
+    }
+
+    printf("Control jitter (%s): n=%llu min=%.1fus avg=%.1fus p99<=%.1fus max=%.1fus\n",
+           label, (unsigned long long)stats->count,
+           stats->minNs / 1000.0, stats->sumNs / 1000.0 / stats->count,
+           (p99 + 1) * JITTER_BUCKET_NS / 1000.0, stats->maxNs / 1000.0);
+    jitterReset(stats);
+}
@@ -0,0 +1,24 @@
+#ifndef RTSCHED_H
+#define RTSCHED_H
+
+#include <stdint.h>
+
+int applySchedConfig(const char* path, const char* role);
+
+#define JITTER_BUCKET_NS 50000ULL
+#define JITTER_BUCKETS 200
+
+// 제어 루프가 예정 시각보다 얼마나 늦게 깨어났는지 모읍니다.
+struct JitterStats {
+    uint64_t count;
+    uint64_t sumNs;
+    uint64_t minNs;
+    uint64_t maxNs;
+    uint32_t hist[JITTER_BUCKETS];
+};
+
+void jitterReset(struct JitterStats* stats);
+void jitterAdd(struct JitterStats* stats, uint64_t lateNs);
+void jitterReport(struct JitterStats* stats, const char* label);
+
+#endif /* RTSCHED_H */
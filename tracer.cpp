@@ -0,0 +1,473 @@
+#include "tracer.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+
+#define TRACE_MAGIC "DGTRACE1"
+#define TRACE_ALIGN 8
+#define TRACE_STAGE_SIZE (4 << 20)   // 프로세스마다 파일에 옮기기 전에 모아 두는 메모리
+#define TRACE_DRAIN_US 5000
+
+// 파일 맨 앞의 헤더. used 는 헤더를 포함해 지금까지 예약된 바이트 수입니다.
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t used;
+    uint64_t dropped;
+    uint64_t startNs;
+    uint64_t reserved[3];
+};
+
+// 레코드 헤더. 페이로드는 8바이트 단위로 패딩됩니다.
+// type 은 마지막에 기록되므로 0 이면 아직 완성되지 않은 레코드입니다.
+struct TraceRecord {
+    uint32_t type;
+    uint32_t len;
+    uint64_t ts;
+};
+
+enum TraceMode traceMode = TRACE_OFF;
+
+static int traceFd = -1;
+static unsigned char* traceBase = NULL;
+static size_t traceCapacity = 0;
+static size_t traceMapped = 0;
+static struct TraceHeader* traceHdr = NULL;
+static int traceOwner = 0;
+
+// 녹화용 상태: traceWrite 는 미리 잡아 둔 메모리에 복사만 하고, 낮은 우선순위의 스레드가 파일로 옮깁니다.
+// 그래서 새 페이지의 폴트나 더티 페이지 쓰기 지연은 제어 스레드가 아니라 그 스레드가 겪습니다.
+static unsigned char* stageBuf = NULL;
+static uint64_t stageHead = 0;       // 지금까지 넣은 바이트
+static uint64_t stageTail = 0;       // 지금까지 파일로 옮긴 바이트
+static int stageStop = 0;
+static pthread_mutex_t stageMutex;
+static pthread_t drainThread;
+
+// 재생용 상태: 종류별 커서와 실시간 재생 기준 시각
+static size_t replayCursor[TRACE_TYPE_COUNT];
+static int replayEnded[TRACE_TYPE_COUNT];
+static int replayRealtime = 0;
+static uint64_t replayFirstTs = 0;
+static uint64_t replayStartNs = 0;
+static pthread_mutex_t replayMutex = PTHREAD_MUTEX_INITIALIZER;
+
+uint64_t monotonicNs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static size_t alignUp(size_t n) {
+    return (n + TRACE_ALIGN - 1) & ~(size_t)(TRACE_ALIGN - 1);
+}
+
+static void stagePut(uint64_t pos, const void* data, size_t len) {
+    size_t at = pos % TRACE_STAGE_SIZE;
+    size_t first = len < TRACE_STAGE_SIZE - at ? len : TRACE_STAGE_SIZE - at;
+    memcpy(stageBuf + at, data, first);
+    memcpy(stageBuf, (const unsigned char*)data + first, len - first);
+}
+
+static void stageGet(uint64_t pos, void* out, size_t len) {
+    size_t at = pos % TRACE_STAGE_SIZE;
+    size_t first = len < TRACE_STAGE_SIZE - at ? len : TRACE_STAGE_SIZE - at;
+    memcpy(out, stageBuf + at, first);
+    memcpy((unsigned char*)out + first, stageBuf, len - first);
+}
+
+// 모아 둔 레코드를 파일에 옮깁니다. 파일 공간은 다른 프로세스와 함께 헤더의 used 로 원자적으로 예약합니다.
+static void* traceDrain(void* arg) {
+    while (1) {
+        pthread_mutex_lock(&stageMutex);
+        uint64_t head = stageHead;
+        uint64_t tail = stageTail;
+        int stop = stageStop;
+        pthread_mutex_unlock(&stageMutex);
+
+        while (tail < head) {
+            struct TraceRecord rec;
+            stageGet(tail, &rec, sizeof(rec));
+            size_t size = sizeof(struct TraceRecord) + alignUp(rec.len);
+            uint64_t off = __atomic_fetch_add(&traceHdr->used, size, __ATOMIC_RELAXED);
+            if (off + size > traceCapacity) {
+                __atomic_fetch_add(&traceHdr->dropped, 1, __ATOMIC_RELAXED);
+            } else {
+                struct TraceRecord* out = (struct TraceRecord*)(traceBase + off);
+                out->len = rec.len;
+                out->ts = rec.ts;
+                stageGet(tail + sizeof(rec), out + 1, rec.len);
+                __atomic_store_n(&out->type, rec.type, __ATOMIC_RELEASE);
+            }
+            tail += sizeof(rec) + rec.len;
+        }
+
+        pthread_mutex_lock(&stageMutex);
+        stageTail = tail;
+        pthread_mutex_unlock(&stageMutex);
+        if (stop) {
+            return NULL;
+        }
+        usleep(TRACE_DRAIN_US);
+    }
+}
+
+// 모아 둘 메모리를 미리 만져 두고 옮기는 스레드를 띄웁니다.
+// 제어 스레드가 SCHED_FIFO 여도 옮기는 스레드는 SCHED_OTHER 로 돌게 합니다.
+static int startDrain(void) {
+    stageBuf = (unsigned char*)malloc(TRACE_STAGE_SIZE);
+    if (stageBuf == NULL) {
+        fprintf(stderr, "Trace stage allocation failed\n");
+        return -1;
+    }
+    memset(stageBuf, 0, TRACE_STAGE_SIZE);
+    stageHead = 0;
+    stageTail = 0;
+    stageStop = 0;
+
+    // 제어 스레드가 기다리는 동안 옮기는 스레드가 밀리지 않게 우선순위를 물려줍니다.
+    pthread_mutexattr_t mattr;
+    pthread_mutexattr_init(&mattr);
+    pthread_mutexattr_setprotocol(&mattr, PTHREAD_PRIO_INHERIT);
+    pthread_mutex_init(&stageMutex, &mattr);
+    pthread_mutexattr_destroy(&mattr);
+
+    pthread_attr_t attr;
+    struct sched_param param;
+    memset(&param, 0, sizeof(param));
+    pthread_attr_init(&attr);
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedpolicy(&attr, SCHED_OTHER);
+    pthread_attr_setschedparam(&attr, &param);
+    int err = pthread_create(&drainThread, &attr, traceDrain, NULL);
+    pthread_attr_destroy(&attr);
+    if (err != 0) {
+        fprintf(stderr, "Trace drain thread: %s\n", strerror(err));
+        free(stageBuf);
+        stageBuf = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+static void stopDrain(void) {
+    if (stageBuf == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&stageMutex);
+    stageStop = 1;
+    pthread_mutex_unlock(&stageMutex);
+    pthread_join(drainThread, NULL);
+    pthread_mutex_destroy(&stageMutex);
+    free(stageBuf);
+    stageBuf = NULL;
+}
+
+int traceOpenRecord(const char* path, size_t capacity) {
+    if (capacity < sizeof(struct TraceHeader) * 2) {
+        fprintf(stderr, "Trace capacity too small\n");
+        return -1;
+    }
+
+    traceFd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (traceFd < 0) {
+        perror("trace open");
+        return -1;
+    }
+    // 미리 블록까지 잡아 두고 한 번만 매핑합니다. 닫을 때 실제 크기로 줄입니다.
+    // fallocate 를 못 쓰는 파일 시스템이면 희소 파일로 둡니다.
+    if (fallocate(traceFd, 0, 0, capacity) < 0 && ftruncate(traceFd, capacity) < 0) {
+        perror("trace ftruncate");
+        close(traceFd);
+        traceFd = -1;
+        return -1;
+    }
+
+    void* base = mmap(NULL, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, traceFd, 0);
+    if (base == MAP_FAILED) {
+        perror("trace mmap");
+        close(traceFd);
+        traceFd = -1;
+        return -1;
+    }
+
+    traceBase = (unsigned char*)base;
+    traceCapacity = capacity;
+    traceMapped = capacity;
+    traceHdr = (struct TraceHeader*)traceBase;
+    memcpy(traceHdr->magic, TRACE_MAGIC, 8);
+    traceHdr->version = 1;
+    traceHdr->headerSize = sizeof(struct TraceHeader);
+    traceHdr->used = sizeof(struct TraceHeader);
+    traceHdr->dropped = 0;
+    traceHdr->startNs = monotonicNs();
+
+    traceOwner = 1;
+    if (startDrain() < 0) {
+        traceClose();
+        return -1;
+    }
+    traceMode = TRACE_RECORD;
+    printf("Recording trace to %s (%zu MB)\n", path, capacity >> 20);
+    return 0;
+}
+
+// 다른 프로세스가 녹화 중인 트레이스 파일에 함께 기록합니다.
+// 공간 예약은 파일 헤더의 used 를 원자적으로 늘리므로 프로세스끼리도 안전합니다.
+int traceAttachRecord(const char* path) {
+    traceFd = open(path, O_RDWR);
+    if (traceFd < 0) {
+        perror("trace open");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(traceFd, &st) < 0 || (size_t)st.st_size < sizeof(struct TraceHeader)) {
+        fprintf(stderr, "Invalid trace file: %s\n", path);
+        close(traceFd);
+        traceFd = -1;
+        return -1;
+    }
+
+    void* base = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, traceFd, 0);
+    if (base == MAP_FAILED) {
+        perror("trace mmap");
+        close(traceFd);
+        traceFd = -1;
+        return -1;
+    }
+
+    traceBase = (unsigned char*)base;
+    traceCapacity = st.st_size;
+    traceMapped = st.st_size;
+    traceHdr = (struct TraceHeader*)traceBase;
+    if (memcmp(traceHdr->magic, TRACE_MAGIC, 8) != 0) {
+        fprintf(stderr, "Invalid trace file: %s\n", path);
+        traceClose();
+        return -1;
+    }
+
+    traceOwner = 0;
+    if (startDrain() < 0) {
+        traceClose();
+        return -1;
+    }
+    traceMode = TRACE_RECORD;
+    return 0;
+}
+
+int traceOpenReplay(const char* path, int realtime) {
+    traceFd = open(path, O_RDONLY);
+    if (traceFd < 0) {
+        perror("trace open");
+        return -1;
+    }
+
+    struct stat st;
+    if (fstat(traceFd, &st) < 0 || (size_t)st.st_size < sizeof(struct TraceHeader)) {
+        fprintf(stderr, "Invalid trace file: %s\n", path);
+        close(traceFd);
+        traceFd = -1;
+        return -1;
+    }
+
+    void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, traceFd, 0);
+    if (base == MAP_FAILED) {
+        perror("trace mmap");
+        close(traceFd);
+        traceFd = -1;
+        return -1;
+    }
+
+    traceBase = (unsigned char*)base;
+    traceCapacity = st.st_size;
+    traceMapped = st.st_size;
+    traceHdr = (struct TraceHeader*)traceBase;
+    if (memcmp(traceHdr->magic, TRACE_MAGIC, 8) != 0) {
+        fprintf(stderr, "Invalid trace file: %s\n", path);
+        traceClose();
+        return -1;
+    }
+    // 녹화 중 비정상 종료된 파일은 used 가 용량보다 클 수 있습니다.
+    if (traceHdr->used < traceCapacity) {
+        traceCapacity = traceHdr->used;
+    }
+
+    for (int i = 0; i < TRACE_TYPE_COUNT; i++) {
+        replayCursor[i] = traceHdr->headerSize;
+        replayEnded[i] = 0;
+    }
+    replayRealtime = realtime;
+    replayFirstTs = traceHdr->startNs;
+    replayStartNs = monotonicNs();
+
+    traceMode = TRACE_REPLAY;
+    printf("Replaying trace %s (%s)\n", path, realtime ? "real time" : "fast");
+    return 0;
+}
+
+// 실시간 재생의 기준 시각. 비전 프로세스는 제어 프로세스의 값을 받아 써서 늦게 뜬 만큼 밀리지 않게 합니다.
+uint64_t traceReplayEpoch(void) {
+    return replayStartNs;
+}
+
+void traceSetReplayEpoch(uint64_t startNs) {
+    replayStartNs = startNs;
+}
+
+// 남은 공간을 한 번에 예약해 이후의 traceWrite 가 모두 버려지게 하고, 그 전까지 예약된 크기로 파일을 줄입니다.
+// 이미 예약을 마친 쓰기는 줄인 크기 안에 있으므로 매핑을 유지하는 동안에는 안전합니다.
+// 헤더의 used 는 용량 이상으로 남겨 둡니다. 되돌리면 예약이 풀려 줄인 파일 밖에 쓰게 됩니다 (SIGBUS).
+// 재생은 파일 크기까지만 읽으므로 그대로 두어도 됩니다.
+static void traceSeal(void) {
+    uint64_t used = __atomic_fetch_add(&traceHdr->used, traceCapacity, __ATOMIC_ACQ_REL);
+    if (used > traceCapacity) {
+        used = traceCapacity;
+    }
+    if (traceHdr->dropped > 0) {
+        fprintf(stderr, "Trace full, dropped %llu records\n", (unsigned long long)traceHdr->dropped);
+    }
+    if (ftruncate(traceFd, used) < 0) {
+        perror("trace ftruncate");
+    }
+}
+
+// 다른 스레드가 모두 끝난 뒤에 부릅니다. 모아 둔 레코드를 마저 옮기고 파일을 확정합니다.
+void traceClose(void) {
+    if (traceBase == NULL) {
+        return;
+    }
+
+    int recording = traceMode == TRACE_RECORD;
+    traceMode = TRACE_OFF;
+    stopDrain();
+    if (recording && traceOwner) {
+        traceSeal();
+    }
+    munmap(traceBase, traceMapped);
+
+    close(traceFd);
+    traceFd = -1;
+    traceBase = NULL;
+    traceHdr = NULL;
+    traceMode = TRACE_OFF;
+}
+
+// 여러 스레드가 동시에 호출해도 됩니다. 모아 둘 메모리가 차면 버리고 dropped 를 늘립니다.
+// 파일에는 traceDrain 이 옮기며, 같은 프로세스에서 같은 종류의 레코드 순서는 그대로 유지됩니다.
+void traceWrite(enum TraceType type, const void* data, uint32_t len) {
+    if (traceMode != TRACE_RECORD) {
+        return;
+    }
+
+    struct TraceRecord rec;
+    rec.type = type;
+    rec.len = len;
+    rec.ts = monotonicNs();
+    size_t size = sizeof(rec) + len;
+
+    pthread_mutex_lock(&stageMutex);
+    if (stageHead - stageTail + size > TRACE_STAGE_SIZE) {
+        pthread_mutex_unlock(&stageMutex);
+        __atomic_fetch_add(&traceHdr->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+    stagePut(stageHead, &rec, sizeof(rec));
+    stagePut(stageHead + sizeof(rec), data, len);
+    stageHead += size;
+    pthread_mutex_unlock(&stageMutex);
+}
+
+// 주어진 종류의 다음 레코드를 돌려줍니다. 페이로드는 매핑된 파일을 그대로 가리킵니다.
+// type 의 다음 레코드를 찾아 cursor 를 그 뒤로 옮깁니다. replayMutex 를 잡고 부릅니다.
+static const struct TraceRecord* findNext(enum TraceType type) {
+    const struct TraceRecord* found = NULL;
+    size_t off = replayCursor[type];
+    while (!replayEnded[type] && off + sizeof(struct TraceRecord) <= traceCapacity) {
+        const struct TraceRecord* rec = (const struct TraceRecord*)(traceBase + off);
+        if (rec->type == TRACE_NONE) {
+            break;
+        }
+        size_t size = sizeof(struct TraceRecord) + alignUp(rec->len);
+        if (off + size > traceCapacity) {
+            break;
+        }
+        off += size;
+
+        if (rec->type == (uint32_t)type) {
+            found = rec;
+            break;
+        }
+    }
+    replayCursor[type] = off;
+    if (found == NULL) {
+        replayEnded[type] = 1;
+    }
+    return found;
+}
+
+// 다음 레코드의 녹화 시각만 봅니다. 넘기지도 기다리지도 않으며, 더 없으면 0 을 돌려줍니다.
+int tracePeek(enum TraceType type, uint64_t* ts) {
+    if (traceMode != TRACE_REPLAY) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&replayMutex);
+    const struct TraceRecord* found = findNext(type);
+    if (found != NULL) {
+        // 다음 traceNext 가 같은 레코드를 돌려주도록 cursor 를 되돌립니다.
+        replayCursor[type] = (const unsigned char*)found - traceBase;
+        *ts = found->ts;
+    }
+    pthread_mutex_unlock(&replayMutex);
+    return found != NULL;
+}
+
+// 실시간 재생이면 녹화 당시의 시각이 될 때까지 기다립니다.
+const void* traceNext(enum TraceType type, uint32_t* len, uint64_t* ts) {
+    if (traceMode != TRACE_REPLAY) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&replayMutex);
+    const struct TraceRecord* found = findNext(type);
+    pthread_mutex_unlock(&replayMutex);
+
+    if (found == NULL) {
+        return NULL;
+    }
+
+    if (replayRealtime) {
+        uint64_t due = replayStartNs + (found->ts - replayFirstTs);
+        uint64_t now = monotonicNs();
+        if (due > now) {
+            struct timespec wait;
+            wait.tv_sec = (due - now) / 1000000000ULL;
+            wait.tv_nsec = (due - now) % 1000000000ULL;
+            nanosleep(&wait, NULL);
+        }
+    }
+
+    if (len) *len = found->len;
+    if (ts) *ts = found->ts;
+    return found + 1;
+}
+
+int traceEnded(enum TraceType type) {
+    return traceMode == TRACE_REPLAY && replayEnded[type];
+}
+
+// 빠른 재생일 때는 제어 루프의 대기를 건너뜁니다.
+void traceUsleep(useconds_t us) {
+    if (traceMode == TRACE_REPLAY && !replayRealtime) {
+        return;
+    }
+    usleep(us);
+}
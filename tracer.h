@@ -0,0 +1,39 @@
+#ifndef TRACER_H
+#define TRACER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <unistd.h>
+
+// 트레이스 레코드 종류
+enum TraceType {
+    TRACE_NONE = 0,
+    TRACE_SENSORS = 1,   // int[4] : left1, left2, right1, right2
+    TRACE_FRAME = 2,     // MJPEG 프레임 (0xFFD8 ... 0xFFD9)
+    TRACE_ACTION = 3,    // 서버로 보낸 ClientAction
+    TRACE_DGIST = 4,     // 서버에서 받은 DGIST
+    TRACE_MOTOR = 5,     // int[4] : ctrl_car 의 l_dir, l_speed, r_dir, r_speed
+    TRACE_TYPE_COUNT
+};
+
+enum TraceMode { TRACE_OFF, TRACE_RECORD, TRACE_REPLAY };
+
+extern enum TraceMode traceMode;
+
+uint64_t monotonicNs(void);
+
+int traceOpenRecord(const char* path, size_t capacity);
+int traceAttachRecord(const char* path);
+int traceOpenReplay(const char* path, int realtime);
+uint64_t traceReplayEpoch(void);
+void traceSetReplayEpoch(uint64_t startNs);
+void traceClose(void);
+
+void traceWrite(enum TraceType type, const void* data, uint32_t len);
+const void* traceNext(enum TraceType type, uint32_t* len, uint64_t* ts);
+int tracePeek(enum TraceType type, uint64_t* ts);
+int traceEnded(enum TraceType type);
+
+void traceUsleep(useconds_t us);
+
+#endif /* TRACER_H */